@@ -0,0 +1,44 @@
+# Checks that every MultiPV line reports a full principal variation. Run with cmake -DENGINE=<tungsten_uci> -DOUTPUT=<log file> -P
+# The input is kept open until the best move is reported, since closing it quits the engine and aborts the search
+
+if (NOT ENGINE OR NOT OUTPUT)
+  message(FATAL_ERROR "Usage: cmake -DENGINE=<tungsten_uci> -DOUTPUT=<log file> -P check_multipv.cmake")
+endif()
+
+set(COMMANDS "setoption name MultiPV value 3\\nposition startpos moves e2e4 e7e5 g1f3 b8c6\\ngo depth 6\\n")
+
+file(REMOVE "${OUTPUT}")
+execute_process(
+  COMMAND sh -c "{ printf '${COMMANDS}'; until grep -q '^bestmove' \"$1\" 2>/dev/null; do sleep 0.1; done; echo quit; } | \"$0\" > \"$1\"" "${ENGINE}" "${OUTPUT}"
+  RESULT_VARIABLE RESULT
+  TIMEOUT 60)
+
+if (NOT RESULT EQUAL 0)
+  message(FATAL_ERROR "The engine failed: ${RESULT}")
+endif()
+
+file(STRINGS "${OUTPUT}" LINES REGEX "^info .* multipv ")
+
+set(CHECKED_LINES 0)
+foreach (LINE IN LISTS LINES)
+  string(REGEX MATCH " depth ([0-9]+) " _ "${LINE}")
+  set(DEPTH ${CMAKE_MATCH_1})
+
+  string(REGEX MATCH " pv (.*)$" _ "${LINE}")
+  separate_arguments(PV UNIX_COMMAND "${CMAKE_MATCH_1}")
+  list(LENGTH PV PV_LENGTH)
+
+  if (DEPTH GREATER_EQUAL 3)
+    math(EXPR CHECKED_LINES "${CHECKED_LINES} + 1")
+
+    if (PV_LENGTH LESS 2)
+      message(FATAL_ERROR "Truncated PV at depth ${DEPTH}: ${LINE}")
+    endif()
+  endif()
+endforeach()
+
+if (CHECKED_LINES EQUAL 0)
+  message(FATAL_ERROR "No MultiPV lines at depth 3 or more in ${OUTPUT}")
+endif()
+
+message(STATUS "Checked ${CHECKED_LINES} MultiPV lines")
\ No newline at end of file
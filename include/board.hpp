@@ -4,14 +4,18 @@
 #include <vector>
 #include <array>
 #include <iostream>
+#include <algorithm>
 
 #include "bitboard.hpp"
 #include "zobrist.hpp"
 #include "magic.hpp"
 #include "types.hpp"
+#include "piece_eval_tables.hpp"
 
 #define NUM_FEN_PARTS 6
 #define NO_EP 8
+#define MAX_MOVES 256 // Upper bound on the number of legal moves in any position (the real maximum is 218)
+#define NULL_MOVE 0   // Integer representation of no move, see Move::toInt()
 
 #define START_FEN "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1"
 
@@ -54,6 +58,13 @@ namespace TungstenChess
     CASTLE = KSIDE_CASTLE | QSIDE_CASTLE
   };
 
+  enum MoveGenerationTypes
+  {
+    ALL_MOVES = 0,
+    CAPTURE_MOVES = 1, // Moves to squares occupied by an enemy piece
+    QUIET_MOVES = 2,   // All other moves (including en passant and non-capturing promotions)
+  };
+
   enum FenParts
   {
     FEN_BOARD = 0,
@@ -64,82 +75,42 @@ namespace TungstenChess
     FEN_FULLMOVE_NUMBER = 5
   };
 
-  struct Move
+  class Move
   {
-    int from;
-    int to;
-    Piece piece;
-    Piece capturedPiece;
-    PieceType promotionPieceType;
-
-    int castlingRights;
-    int enPassantFile;
-
-    int halfmoveClock;
-
-    int flags;
-
+  public:
     Move() = default;
 
     /**
      * @param from The square the piece is moving from
      * @param to The square the piece is moving to
-     * @param piece The piece that is moving
-     * @param capturedPiece The piece that is being captured, if any
-     * @param enPassantFile The current state of the en passant file, used to restore it when the move is unmade
-     * @param castlingRights The current state of the castling rights, used to restore them when the move is unmade
+     * @param flags The move flags, see enum MoveFlags (use Board::generateMove to compute them from a position)
      * @param promotionPieceType The piece that the moving piece is being promoted to, if any (only piece type)
      */
-    Move(int from, int to, Piece piece, Piece capturedPiece, int castlingRights, int enPassantFile, int halfmoveClock, PieceType promotionPieceType = EMPTY)
-        : from(from), to(to), piece(piece), capturedPiece(capturedPiece), castlingRights(castlingRights), enPassantFile(enPassantFile), halfmoveClock(halfmoveClock), promotionPieceType(promotionPieceType), flags(NORMAL)
-    {
-      PieceType pieceType = piece & TYPE;
-
-      if (pieceType == KING && from - to == -2)
-      {
-        this->flags |= KSIDE_CASTLE;
-        return;
-      }
-
-      if (pieceType == KING && from - to == 2)
-      {
-        this->flags |= QSIDE_CASTLE;
-        return;
-      }
-
-      if (pieceType == PAWN && (from - to == 16 || from - to == -16))
-      {
-        this->flags |= PAWN_DOUBLE;
-        return;
-      }
-
-      if (pieceType == PAWN && capturedPiece == EMPTY && (to - from) % 8)
-      {
-        this->flags |= EP_CAPTURE;
-        return;
-      }
-
-      if (capturedPiece != EMPTY)
-      {
-        this->flags |= CAPTURE;
-      }
-
-      if (pieceType == PAWN && (to <= 7 || to >= 56))
-      {
-        this->flags |= PROMOTION;
-      }
-    }
+    Move(int from, int to, int flags, PieceType promotionPieceType = EMPTY)
+        : m_data(from | (to << 6) | (promotionPieceType << 12) | (flags << 15)) {}
 
     /**
      * @param move The move to copy
      * @param promotionPieceType The new promotion piece type
      */
-    Move(const Move &move, PieceType promotionPieceType) : from(move.from), to(move.to), piece(move.piece), capturedPiece(move.capturedPiece), castlingRights(move.castlingRights), enPassantFile(move.enPassantFile), halfmoveClock(move.halfmoveClock), promotionPieceType(promotionPieceType), flags(move.flags) {}
+    Move(const Move &move, PieceType promotionPieceType) : m_data((move.m_data & ~(0x7 << 12)) | (promotionPieceType << 12)) {}
+
+    /**
+     * Returns the move standing for no move, whose integer representation is NULL_MOVE
+     */
+    static Move nullMove() { return Move(0, 0, NORMAL); }
+
+    bool isNull() const { return toInt() == NULL_MOVE; }
+
+    int from() const { return m_data & 0x3F; }
+    int to() const { return (m_data >> 6) & 0x3F; }
+    PieceType promotionPieceType() const { return (m_data >> 12) & 0x7; }
+    int flags() const { return m_data >> 15; }
 
     /**
-     * Returns an integer representation of the move
+     * Returns an integer representation of the move (from, to and promotion piece type)
      */
-    MoveInt toInt() const { return from | (to << 6); }
+    MoveInt toInt() const { return m_data & 0x7FFF; }
 
     /**
      * Returns a UCI string representation of the move
@@ -148,16 +119,70 @@ namespace TungstenChess
     {
       std::string uci = "";
 
-      uci += 'a' + (from % 8);
-      uci += '8' - (from / 8);
-      uci += 'a' + (to % 8);
-      uci += '8' - (to / 8);
+      uci += 'a' + (from() % 8);
+      uci += '8' - (from() / 8);
+      uci += 'a' + (to() % 8);
+      uci += '8' - (to() / 8);
 
-      if (promotionPieceType != EMPTY)
-        uci += ".pnbrqk"[promotionPieceType];
+      if (promotionPieceType() != EMPTY)
+        uci += ".pnbrqk"[promotionPieceType()];
 
       return uci;
     }
+
+  private:
+    uint32_t m_data; // from (6 bits), to (6 bits), promotion piece type (3 bits), flags (6 bits)
+  };
+
+  /**
+   * Irreversible board state saved by makeMove so that unmakeMove can restore it
+   */
+  struct UndoState
+  {
+    Piece capturedPiece;
+    uint8_t castlingRights;
+    uint8_t enPassantFile;
+    int halfmoveClock;
+  };
+
+  /**
+   * Legality information for one side, computed once per move generation so that legal moves can be found by masking pseudo-legal moves
+   */
+  struct MoveGenerationMasks
+  {
+    Bitboard checkers;  // Enemy pieces giving check
+    Bitboard checkMask; // Squares a non-king move must land on to resolve a single check (all squares if not in check, none in double check)
+    Bitboard pinned;    // Friendly pieces pinned to the king, which may only move along the line through the king
+  };
+
+  class MoveList
+  {
+  public:
+    MoveList() : m_size(0) {}
+
+    /**
+     * @brief Adds a move to the end of the list (no bounds checking, the list can hold MAX_MOVES moves)
+     * @param move The move to add
+     */
+    void push_back(const Move &move) { m_moves[m_size++] = move; }
+
+    Move &operator[](size_t index) { return m_moves[index]; }
+    const Move &operator[](size_t index) const { return m_moves[index]; }
+
+    Move &back() { return m_moves[m_size - 1]; }
+
+    size_t size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+
+    Move *begin() { return m_moves.data(); }
+    Move *end() { return m_moves.data() + m_size; }
+    const Move *begin() const { return m_moves.data(); }
+    const Move *end() const { return m_moves.data() + m_size; }
+
+  private:
+    std::array<Move, MAX_MOVES> m_moves; // Stack allocated and left uninitialized, only the first m_size moves are valid
+
+    size_t m_size;
   };
 
   class Board
@@ -177,10 +202,14 @@ namespace TungstenChess
     std::array<Bitboard, ALL_PIECES + 1> m_bitboards;
 
     ZobristKey m_zobristKey;
+    ZobristKey m_pawnZobristKey = 0; // Zobrist key of the pawns only (used for the pawn hash table)
+
+    int m_materialEvaluation = 0;    // Material balance, positive for white favor (updated incrementally, see updatePiece)
+    int m_pieceSquareEvaluation = 0; // Piece-square table balance of all pieces except kings, positive for white favor (updated incrementally, see updatePiece)
 
     std::vector<MoveInt> m_moveHistory;
 
-    const bool m_isDefaultStartPosition; // Whether the board is in the default starting position (used for determining whether opening book can be used)
+    std::vector<UndoState> m_undoStack; // One entry per move made, see makeMove/unmakeMove
 
     std::array<int, PIECE_NUMBER> m_kingIndices; // Only indexes WHITE_KING and BLACK_KING are valid, the rest are garbage
 
@@ -191,7 +220,7 @@ namespace TungstenChess
     const MagicMoveGen &magicMoveGen = MagicMoveGen::getInstance();
 
   public:
-    Board(std::string fen = START_FEN) : m_isDefaultStartPosition(fen == START_FEN)
+    Board(std::string fen = START_FEN)
     {
       resetBoard(fen);
     }
@@ -205,8 +234,11 @@ namespace TungstenChess
     int halfmoveClock() { return m_halfmoveClock; }
     Bitboard bitboard(Piece piece) { return m_bitboards[piece]; }
     ZobristKey zobristKey() { return m_zobristKey; }
+    ZobristKey pawnZobristKey() { return m_pawnZobristKey; }
+    int materialEvaluation() { return m_materialEvaluation; }
+    int pieceSquareEvaluation() { return m_pieceSquareEvaluation; }
     std::vector<MoveInt> moveHistory() { return m_moveHistory; }
-    bool isDefaultStartPosition() { return m_isDefaultStartPosition; }
+    MoveInt lastMove() { return m_moveHistory.empty() ? NULL_MOVE : m_moveHistory.back(); }
     int kingIndex(Piece piece) { return m_kingIndices[piece]; }
 
     /**
@@ -234,17 +266,37 @@ namespace TungstenChess
     }
 
     /**
-     * @brief Makes a move on the board
+     * @brief Makes a move on the board, saving the irreversible state to the undo stack
      * @param move The move to make
      */
     void makeMove(Move move);
 
     /**
-     * @brief Undoes a move, handling all board state changes
-     * @param move The move to undo
+     * @brief Undoes a move, handling all board state changes (the irreversible state is restored from the undo stack)
+     * @param move The move to undo, must be the last move made
      */
     void unmakeMove(Move move);
 
+    /**
+     * @brief Static exchange evaluation: the material balance of the sequence of captures on the target square of a move, assuming both
+     *        sides always recapture with their least valuable attacker and may stop capturing at any point. Handles x-ray attackers
+     *        (sliders behind other attackers), but not pins or checks
+     * @param move The move to evaluate (usually a capture)
+     * @return The material gained by the side making the move, in centipawns (negative if the exchange loses material)
+     */
+    int see(Move move);
+
+    /**
+     * @brief Passes the turn without moving a piece (used for null move pruning). Clears the en passant file and resets the halfmove clock,
+     *        so that positions before the null move are never counted as repetitions. The null move is recorded as NULL_MOVE in the move history
+     */
+    void makeNullMove();
+
+    /**
+     * @brief Undoes a null move, must be the last move made
+     */
+    void unmakeNullMove();
+
     /**
      * @brief Returns the game status for the current side - see enum GameStatus
      * @param color The color to check
@@ -252,6 +304,41 @@ namespace TungstenChess
      */
     int getGameStatus(PieceColor color);
 
+    /**
+     * @brief Generates a move from the current position, computing its flags from the pieces on the board
+     * @param from The square the piece is moving from
+     * @param to The square the piece is moving to
+     * @param promotionPieceType The piece type to promote to, if any
+     */
+    Move generateMove(int from, int to, PieceType promotionPieceType = EMPTY)
+    {
+      Piece piece = m_board[from];
+      Piece capturedPiece = m_board[to];
+      PieceType pieceType = piece & TYPE;
+
+      if (pieceType == KING && from - to == -2)
+        return Move(from, to, KSIDE_CASTLE);
+
+      if (pieceType == KING && from - to == 2)
+        return Move(from, to, QSIDE_CASTLE);
+
+      if (pieceType == PAWN && (from - to == 16 || from - to == -16))
+        return Move(from, to, PAWN_DOUBLE);
+
+      if (pieceType == PAWN && capturedPiece == EMPTY && (to - from) % 8)
+        return Move(from, to, EP_CAPTURE);
+
+      int flags = NORMAL;
+
+      if (capturedPiece != EMPTY)
+        flags |= CAPTURE;
+
+      if (pieceType == PAWN && (to <= 7 || to >= 56))
+        flags |= PROMOTION;
+
+      return Move(from, to, flags, promotionPieceType);
+    }
+
     /**
      * @brief Generates a move from a UCI string
      * @param uci The UCI string
@@ -265,41 +352,88 @@ namespace TungstenChess
     std::string getMovePGN(Move move);
 
     /**
-     * @brief Counts the number of games that can be played from the current position to a given depth
+     * @brief Counts the number of games that can be played from the current position to a given depth (perft),
+     *        bulk counting the legal moves at the last ply instead of making them
      * @param depth The depth to search to
-     * @param verbose Whether to print the number of games found after each 1-deep move
      */
-    int countGames(int depth, bool verbose = true);
+    uint64_t countGames(int depth);
 
     /**
      * @brief Gets the legal moves for a color
      * @param color The color to get the moves for
-     * @param onlyCaptures Whether to only include capture moves
+     * @param generationType Which moves to include, see enum MoveGenerationTypes
      */
-    std::vector<Move> getLegalMoves(PieceColor color, bool onlyCaptures = false);
+    MoveList getLegalMoves(PieceColor color, int generationType = ALL_MOVES);
 
     /**
-     * @brief Counts the number of times a position has been repeated
-     * @param key The Zobrist key of the position to check
+     * @brief Counts the number of earlier occurrences of the current position (so 2 means threefold repetition). Only the positions since the
+     *        last irreversible move (see halfmoveClock) with the same side to move can be repetitions, so only those are scanned
      */
-    int countRepetitions(ZobristKey key)
+    int countRepetitions()
     {
       int count = 0;
 
-      for (size_t i = 0; i < m_positionHistory.size(); i++)
-        if (m_positionHistory[i] == key)
+      int lastIndex = m_positionHistory.size() - 1;
+      int firstIndex = std::max(lastIndex - m_halfmoveClock, 0);
+
+      for (int i = lastIndex - 2; i >= firstIndex; i -= 2)
+        if (m_positionHistory[i] == m_zobristKey)
           count++;
 
       return count;
     }
 
+    /**
+     * @brief Checks whether the current position is a draw by repetition for a search. A repetition of a position reached inside the search
+     *        tree is a draw, since the side that repeated could repeat again, but positions from before the root need a threefold repetition
+     * @param ply The distance from the root of the search
+     */
+    bool isRepetition(int ply)
+    {
+      int count = 0;
+
+      int lastIndex = m_positionHistory.size() - 1;
+      int firstIndex = std::max(lastIndex - m_halfmoveClock, 0);
+
+      for (int i = lastIndex - 2; i >= firstIndex; i -= 2)
+        if (m_positionHistory[i] == m_zobristKey && (i > lastIndex - ply || ++count == 2))
+          return true;
+
+      return false;
+    }
+
   private:
     /**
-     * @brief Calculates the Zobrist key for the current position. Should only be called once at board initialization
-     *        After, the key is updated incrementally with updatePiece, updateCastlingRights, etc
+     * @brief Calculates the Zobrist key and the pawn Zobrist key for the current position. Should only be called once at board initialization
+     *        After, the keys are updated incrementally with updatePiece, updateCastlingRights, etc
      */
     void calculateInitialZobristKey();
 
+    /**
+     * @brief Calculates the material and piece-square table evaluations for the current position. Should only be called once at board initialization
+     *        After, they are updated incrementally with updatePiece
+     */
+    void calculateInitialEvaluation();
+
+    /**
+     * @brief Gets the material value of a piece, negative for black pieces
+     * @param piece The piece
+     */
+    static int getPieceMaterial(Piece piece)
+    {
+      return (piece & BLACK) ? -PIECE_VALUES[piece & TYPE] : PIECE_VALUES[piece & TYPE];
+    }
+
+    /**
+     * @brief Gets the piece-square table value of a piece, negative for black pieces (always 0 for kings, which are evaluated separately)
+     * @param piece The piece
+     * @param pieceIndex The index of the piece
+     */
+    static int getPieceSquareValue(Piece piece, int pieceIndex)
+    {
+      return (piece & BLACK) ? -PIECE_EVAL_TABLES[piece][pieceIndex] : PIECE_EVAL_TABLES[piece][pieceIndex];
+    }
+
     /**
      * @brief Updates bitboards for a single changing piece
      * @param pieceIndex The index of the piece
@@ -419,7 +553,7 @@ namespace TungstenChess
     }
 
     /**
-     * @brief Updates the piece at a given index and handles bitboard and Zobrist key updates
+     * @brief Updates the piece at a given index and handles bitboard, Zobrist key and evaluation updates
      * @param pieceIndex The index of the piece to update
      * @param newPiece The new piece
      */
@@ -429,6 +563,14 @@ namespace TungstenChess
 
       m_zobristKey ^= zobrist.getPieceCombinationKey(pieceIndex, oldPiece, newPiece);
 
+      if ((oldPiece & TYPE) == PAWN)
+        m_pawnZobristKey ^= zobrist.pieceKeys[pieceIndex][oldPiece];
+      if ((newPiece & TYPE) == PAWN)
+        m_pawnZobristKey ^= zobrist.pieceKeys[pieceIndex][newPiece];
+
+      m_materialEvaluation += getPieceMaterial(newPiece) - getPieceMaterial(oldPiece);
+      m_pieceSquareEvaluation += getPieceSquareValue(newPiece, pieceIndex) - getPieceSquareValue(oldPiece, pieceIndex);
+
       m_kingIndices[newPiece] = pieceIndex;
       m_board[pieceIndex] = newPiece;
 
@@ -527,16 +669,98 @@ namespace TungstenChess
      * @brief Returns the bitboard of the squares a piece can move to
      * @param pieceIndex The index of the piece
      * @param color The color of the piece
+     * @param generationType Which moves to include, see enum MoveGenerationTypes
+     */
+    Bitboard getLegalPieceMovesBitboard(int pieceIndex, PieceColor color, int generationType = ALL_MOVES);
+
+    /**
+     * @brief Returns the bitboard of target squares allowed by a move generation type
+     * @param color The color of the moving pieces
+     * @param generationType See enum MoveGenerationTypes
+     */
+    Bitboard getGenerationMask(PieceColor color, int generationType)
+    {
+      if (generationType == CAPTURE_MOVES)
+        return m_bitboards[color ^ COLOR];
+      if (generationType == QUIET_MOVES)
+        return ~m_bitboards[color ^ COLOR];
+
+      return ~0ULL;
+    }
+
+    /**
+     * @brief Returns the bitboard of the squares a piece can move to, using precomputed legality masks
+     * @param pieceIndex The index of the piece
+     * @param color The color of the piece
+     * @param masks The legality masks for the color, see getMoveGenerationMasks
+     * @param generationType Which moves to include, see enum MoveGenerationTypes
+     */
+    Bitboard getLegalPieceMovesBitboard(int pieceIndex, PieceColor color, const MoveGenerationMasks &masks, int generationType);
+
+    /**
+     * @brief Adds the legal moves of a set of unpinned pawns to a move list, generating each kind of pawn move for all pawns at once with bitboard shifts
+     * @param legalMoves The move list to add the moves to
+     * @param color The color of the pawns
+     * @param pawns The pawns to generate moves for (must not be pinned)
+     * @param checkMask The check evasion mask, see MoveGenerationMasks
+     * @param generationMask The target squares allowed by the move generation type, see getGenerationMask
+     */
+    void addPawnMoves(MoveList &legalMoves, PieceColor color, Bitboard pawns, Bitboard checkMask, Bitboard generationMask);
+
+    /**
+     * @brief Adds a legal move to a move list, expanding promotions into one move per promotion piece
+     * @param legalMoves The move list to add the move to
+     * @param from The square the move is from
+     * @param to The square the move is to
      */
-    Bitboard getLegalPieceMovesBitboard(int pieceIndex, PieceColor color, bool onlyCaptures = false);
+    void addMove(MoveList &legalMoves, int from, int to)
+    {
+      Move move = generateMove(from, to);
+
+      if (move.flags() & PROMOTION)
+      {
+        legalMoves.push_back(Move(move, QUEEN));
+        legalMoves.push_back(Move(move, KNIGHT));
+        legalMoves.push_back(Move(move, BISHOP));
+        legalMoves.push_back(Move(move, ROOK));
+      }
+      else
+        legalMoves.push_back(move);
+    }
 
     /**
-     * @brief Returns the bitboard of pieces that can move to a given square. Does not include kings for technical reasons
-     * @param targetSquare The square to check
-     * @param targetPiece The piece on the target square
-     * @param color The color of the pieces moving
+     * @brief Computes the checkers, check evasion mask and pinned pieces for a color
+     * @param color The color to move
      */
-    Bitboard getAttackingPiecesBitboard(int targetSquare, Piece targetPiece, PieceColor color);
+    MoveGenerationMasks getMoveGenerationMasks(PieceColor color);
+
+    /**
+     * @brief Returns the bitboard of squares attacked by a color, given an occupancy of the board
+     *        (used for king moves, with the moving king removed from the occupancy so that it cannot step back along a checking ray)
+     * @param color The attacking color
+     * @param occupied The occupancy to use for slider attacks
+     */
+    Bitboard getAttackedSquares(PieceColor color, Bitboard occupied);
+
+    /**
+     * @brief Returns the bitboard of pieces of both colors that attack a square, including kings, given an occupancy of the board
+     *        (used for static exchange evaluation, where pieces are removed from the occupancy as they capture)
+     * @param square The square to check
+     * @param occupied The occupancy to use for slider attacks
+     */
+    Bitboard getAttackersBitboard(int square, Bitboard occupied)
+    {
+      Bitboard bishopAttackers = m_bitboards[WHITE_BISHOP] | m_bitboards[BLACK_BISHOP] | m_bitboards[WHITE_QUEEN] | m_bitboards[BLACK_QUEEN];
+      Bitboard rookAttackers = m_bitboards[WHITE_ROOK] | m_bitboards[BLACK_ROOK] | m_bitboards[WHITE_QUEEN] | m_bitboards[BLACK_QUEEN];
+
+      return ((movesLookup.PAWN_CAPTURE_MOVES[BLACK][square] & m_bitboards[WHITE_PAWN]) |
+              (movesLookup.PAWN_CAPTURE_MOVES[WHITE][square] & m_bitboards[BLACK_PAWN]) |
+              (movesLookup.KNIGHT_MOVES[square] & (m_bitboards[WHITE_KNIGHT] | m_bitboards[BLACK_KNIGHT])) |
+              (movesLookup.KING_MOVES[square] & (m_bitboards[WHITE_KING] | m_bitboards[BLACK_KING])) |
+              (magicMoveGen.getBishopMoves(square, occupied) & bishopAttackers) |
+              (magicMoveGen.getRookMoves(square, occupied) & rookAttackers)) &
+             occupied;
+    }
 
     Bitboard getPawnMoves(int pieceIndex, PieceColor color, bool _ = false);
     Bitboard getKnightMoves(int pieceIndex, PieceColor color, bool _ = false);
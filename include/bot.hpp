@@ -1,28 +1,68 @@
 #pragma once
 
 #include <iostream>
+#include <sstream>
 #include <chrono>
 #include <algorithm>
+#include <atomic>
+#include <thread>
+#include <memory>
+#include <functional>
+#include <cstdlib>
 
 #include "board.hpp"
 #include "opening_book.hpp"
 #include "piece_eval_tables.hpp"
+#include "transposition_table.hpp"
+#include "move_picker.hpp"
+#include "reductions.hpp"
+#include "search_history.hpp"
+#include "pawn_hash_table.hpp"
+#include "time_manager.hpp"
+#include "uci_output.hpp"
 
 #define POSITIVE_INFINITY 1000000
 #define NEGATIVE_INFINITY -1000000
 
+#define MAX_SEARCH_DEPTH 64
+#define MAX_PLY 128 // Maximum distance from the root, including quiescence search
+
+#define MATE_SCORE 100000 // Score for delivering checkmate at the root, mates further from the root score one less per ply
+
+#define DRAW_SCORE 0 // Score for a draw by repetition or the fifty move rule
+
+#define ASPIRATION_WINDOW 50 // Initial half-width of the aspiration window, doubled after every failed search
+#define MAX_ASPIRATION_WINDOW 1000 // Beyond this half-width, the search falls back to a full window
+
+#define NULL_MOVE_MIN_DEPTH 3  // Minimum remaining depth for null move pruning
+#define LMR_MIN_DEPTH 3        // Minimum remaining depth for late move reductions
+#define LMR_MIN_MOVE_NUMBER 4  // Moves before this one (in move ordering) are never reduced
+
 namespace TungstenChess
 {
   struct BotSettings
   {
-    int maxSearchTime = 500; // In milliseconds, not a hard limit
+    int maxSearchTime = 500; // In milliseconds, hard limit for iterative deepening (the search is aborted once it runs out)
+    int maxSearchNodes = 0;  // Hard limit on nodes searched by the main thread, 0 for no limit
     int minSearchDepth = 3;  // for iterative deepening
     int maxSearchDepth = 5;  // for fixed depth search
     int quiesceDepth = 10;
-    bool useOpeningBook = true; // only used if board starting position is default
+    int transpositionTableSize = 64; // In megabytes
+    int threads = 1;                 // Number of search threads, including the main thread (Lazy SMP)
+    bool useOpeningBook = true; // only used if an opening book is loaded, see Bot::loadOpeningBook
     bool logSearchInfo = true;
     bool logPGNMoves = true;      // as opposed to UCI moves
     bool fixedDepthSearch = true; // as opposed to iterative deepening
+    bool useNullMovePruning = true;
+    bool useLateMoveReductions = true;
+    int multiPV = 1; // Number of best root moves to find, each with its own score and principal variation (see Bot::getSearchLines)
+  };
+
+  struct SearchLine
+  {
+    Move move;                            // The root move of the line
+    int score;                            // From the perspective of the side to move
+    std::vector<Move> principalVariation; // Starting with the root move
   };
 
   enum EvaluationBonus
@@ -44,71 +84,277 @@ namespace TungstenChess
   class Bot
   {
   public:
-    Bot(Board &board, const BotSettings &settings) : board(board), botSettings(settings)
-    {
-      openingBook.inOpeningBook = board.isDefaultStartPosition();
-    }
+    Bot(Board &board, const BotSettings &settings) : board(board), botSettings(settings), transpositionTable(std::make_shared<TranspositionTable>(settings.transpositionTableSize)) {}
 
     Bot(Board &board) : Bot(board, BotSettings()) {}
 
+    ~Bot()
+    {
+      stopSearch();
+      waitForSearch();
+    }
+
     int positionsEvaluated;
     int depthSearched;
+    uint64_t nodesSearched;
 
     /**
-     * @brief Loads the opening book from a file
+     * @brief Loads the opening book from a file, see OpeningBook::loadOpeningBook
      * @param path The path to the opening book file
-     * @param openingBookSize The number of entries in the opening book (i.e. the size of the file in bytes divided by 4)
+     * @return Whether the book was loaded
+     */
+    bool loadOpeningBook(const std::string &path)
+    {
+      return openingBook.loadOpeningBook(path);
+    }
+
+    /**
+     * @brief Generates the best move for the bot, with the search limits from the bot settings
+     */
+    Move generateBotMove() { return generateBotMove(getDefaultSearchLimits()); }
+
+    /**
+     * @brief Gets the search limits set by the bot settings (a fixed depth or a fixed time, and a node limit)
+     */
+    SearchLimits getDefaultSearchLimits() const
+    {
+      SearchLimits limits;
+
+      if (botSettings.fixedDepthSearch)
+        limits.depth = botSettings.maxSearchDepth;
+      else
+        limits.moveTime = botSettings.maxSearchTime;
+
+      limits.nodes = botSettings.maxSearchNodes;
+
+      return limits;
+    }
+
+    /**
+     * @brief Generates the best move for the bot within the given search limits (the opening book is still used if enabled)
+     * @param limits The limits of the search, see SearchLimits. Without any limits, the search runs until stopped (see stopSearch)
+     * @return The best move, or the null move (see Move::nullMove) if there are no legal moves
+     */
+    Move generateBotMove(const SearchLimits &limits);
+
+    /**
+     * @brief Starts generating the best move on a separate search thread and returns immediately. The board must not be changed until
+     *        the search has finished (see waitForSearch)
+     * @param limits The limits of the search, see generateBotMove
+     * @param onSearchFinished Called on the search thread with the best move once the search has finished
+     */
+    void startSearch(const SearchLimits &limits, std::function<void(Move)> onSearchFinished);
+
+    /**
+     * @brief Blocks until the search started by startSearch has finished, including its callback. Returns immediately if there is none
+     */
+    void waitForSearch()
+    {
+      if (searchThread.joinable())
+        searchThread.join();
+    }
+
+    /**
+     * @brief Gets the lines found by the last completed iteration of the last search, best first (one per BotSettings::multiPV,
+     *        or fewer if there are not enough legal moves). Must not be called while a search is running
+     */
+    const std::vector<SearchLine> &getSearchLines() const { return searchLines; }
+
+    /**
+     * @brief Clears the transposition table (should be called when starting a new game)
      */
-    void loadOpeningBook(const std::string path, uint openingBookSize)
+    void clearTranspositionTable() { transpositionTable->clear(); }
+
+    /**
+     * @brief Updates the bot settings, resizing the transposition table if needed. Must not be called while a search is running
+     * @param settings The new settings
+     */
+    void updateSettings(const BotSettings &settings)
     {
-      openingBook.loadOpeningBook(path, openingBookSize);
+      botSettings = settings;
+
+      if (transpositionTable->size() != settings.transpositionTableSize)
+        transpositionTable->resize(settings.transpositionTableSize);
     }
 
     /**
-     * @brief Generates the best move for the bot
+     * @brief Signals a running search to stop as soon as possible. Safe to call from another thread
      */
-    Move generateBotMove();
+    void stopSearch() { searchStopped.store(true, std::memory_order_relaxed); }
+
+    /**
+     * @brief Signals a search started with SearchLimits::ponder that the ponder move was played, so its time limits start to apply from now.
+     *        Safe to call from another thread
+     */
+    void ponderHit() { pondering.store(false, std::memory_order_relaxed); }
 
   private:
+    /**
+     * @brief Creates a helper bot for multithreaded search, which shares the transposition table of the main bot
+     * @param board The helper's own copy of the board
+     * @param settings The settings of the main bot
+     * @param transpositionTable The transposition table of the main bot
+     */
+    Bot(Board &board, const BotSettings &settings, std::shared_ptr<TranspositionTable> transpositionTable)
+        : board(board), botSettings(settings), transpositionTable(transpositionTable) {}
+
     Board &board;
     OpeningBook openingBook;
 
-    const BotSettings botSettings;
+    BotSettings botSettings;
+
+    std::shared_ptr<TranspositionTable> transpositionTable;
+
+    SearchHistory searchHistory; // Per thread, aged at the start of each search
+
+    PawnHashTable pawnHashTable; // Per thread, kept between searches
+
+    const LateMoveReductions &lateMoveReductions = LateMoveReductions::getInstance();
+
+    std::atomic<bool> searchStopped{false};
+    std::atomic<bool> pondering{false}; // Set while a ponder search waits for the ponder move to be played
+    bool waitingForPonderHit = false;   // Whether the search thread has yet to see pondering cleared (only used by the search thread)
+
+    std::thread searchThread; // See startSearch
+
+    std::vector<std::unique_ptr<Bot>> helperBots; // Helper threads of a running parallel search, see parallelSearch
+    std::atomic<uint64_t> reportedNodes{0};       // nodesSearched as last published by countNode, readable from other threads
+
+    std::chrono::time_point<std::chrono::high_resolution_clock> searchInfoStart; // Unlike searchStart, not reset by a ponder hit
+    std::chrono::time_point<std::chrono::high_resolution_clock> searchStart;
+    TimeManager timeManager;
+    int searchTimeLimit = 0;      // In milliseconds, 0 for no limit (the hard limit of the time manager)
+    uint64_t searchNodeLimit = 0; // 0 for no limit
+
+    int searchScore = 0; // Score of the last root search, see generateBestMove
+
+    int selectiveDepth = 0; // Maximum ply reached in the current iteration, including quiescence search
+
+    // Triangular principal variation table: pvTable[ply] holds the best line found from ply onwards, up to pvLength[ply]
+    std::array<std::array<Move, MAX_PLY>, MAX_PLY> pvTable;
+    std::array<int, MAX_PLY> pvLength;
+
+    std::vector<SearchLine> searchLines;  // Of the last completed iteration, best first
+    std::vector<MoveInt> excludedRootMoves; // Root moves of the better lines in the current iteration, skipped by generateBestMove
+
+    /**
+     * @brief Whether the current search has been stopped, in which case all search results are invalid
+     */
+    bool isSearchStopped() const { return searchStopped.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief Counts a searched node and stops the search if the time or node limit has been reached
+     *        The clock is only read every 1024 nodes to keep the check cheap
+     */
+    void countNode()
+    {
+      if (++nodesSearched & 1023)
+        return;
+
+      reportedNodes.store(nodesSearched, std::memory_order_relaxed);
+
+      if (searchNodeLimit && nodesSearched >= searchNodeLimit)
+        stopSearch();
+
+      if (searchTimeLimit && getSearchTime() >= searchTimeLimit)
+        stopSearch();
+    }
+
+    /**
+     * @brief Gets the time in milliseconds the current search has been running for. While pondering this is always 0,
+     *        and after a ponder hit it is counted from the ponder hit (see ponderHit)
+     */
+    int getSearchTime()
+    {
+      if (waitingForPonderHit)
+      {
+        if (pondering.load(std::memory_order_relaxed))
+          return 0;
+
+        waitingForPonderHit = false;
+        searchStart = std::chrono::high_resolution_clock::now();
+      }
+
+      return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - searchStart).count();
+    }
+
+    /**
+     * @brief Gets the number of nodes searched by the main thread and the helper threads in the current search
+     */
+    uint64_t getTotalNodesSearched() const
+    {
+      uint64_t totalNodes = nodesSearched;
+
+      for (const std::unique_ptr<Bot> &helperBot : helperBots)
+        totalNodes += helperBot->reportedNodes.load(std::memory_order_relaxed);
+
+      return totalNodes;
+    }
+
+    /**
+     * @brief Whether a score is a forced checkmate for either side
+     * @param score The score to check
+     */
+    static bool isMateScore(int score) { return std::abs(score) >= MATE_SCORE - MAX_PLY; }
 
     /**
-     * @brief Gets the legal moves for a color, sorted by heuristic evaluation
-     * @param color The color to get the moves for
-     * @param onlyCaptures Whether to only get captures
+     * @brief Converts a score relative to the root into one relative to the current position for storing in the transposition table,
+     *        so that mate scores stay correct when the position is reached at a different ply
+     * @param score The score to convert
+     * @param ply The distance from the root of the search
      */
-    std::vector<Move> getSortedLegalMoves(PieceColor color, bool onlyCaptures = false)
+    static int scoreToTranspositionTable(int score, int ply)
     {
-      std::vector<Move> moves = board.getLegalMoves(color, onlyCaptures);
-      heuristicSortMoves(moves);
-      return moves;
+      return score >= MATE_SCORE - MAX_PLY ? score + ply : score <= -MATE_SCORE + MAX_PLY ? score - ply : score;
     }
 
     /**
-     * @brief Gets the positional evaluation of a single piece
-     * @param pieceIndex The index of the piece
-     * @param absolute Whether to return the value of the evaluation as if the piece was white (true for heuristic evaluation, false for static evaluation)
+     * @brief Converts a score from the transposition table back into one relative to the root, see scoreToTranspositionTable
+     * @param score The score to convert
+     * @param ply The distance from the root of the search
      */
-    int getPiecePositionalEvaluation(int pieceIndex, bool absolute = false) const
+    static int scoreFromTranspositionTable(int score, int ply)
     {
-      int positionalEvaluation = 0;
+      return score >= MATE_SCORE - MAX_PLY ? score - ply : score <= -MATE_SCORE + MAX_PLY ? score + ply : score;
+    }
+
+    /**
+     * @brief Records a new best move at a ply, extending it with the principal variation of the next ply
+     * @param ply The distance from the root of the search
+     * @param move The new best move
+     */
+    void updatePrincipalVariation(int ply, Move move)
+    {
+      pvTable[ply][ply] = move;
+
+      for (int i = ply + 1; i < pvLength[ply + 1]; i++)
+        pvTable[ply][i] = pvTable[ply + 1][i];
 
-      positionalEvaluation = PIECE_EVAL_TABLES[board[pieceIndex]][pieceIndex];
+      pvLength[ply] = std::max(pvLength[ply + 1], ply + 1);
+    }
 
-      if (!absolute && (board[pieceIndex] & BLACK))
-        positionalEvaluation = -positionalEvaluation;
+    /**
+     * @brief Prints a UCI "info" line for a line of a completed iterative deepening iteration
+     * @param depth The depth of the iteration
+     * @param lineIndex The index of the line in searchLines
+     */
+    void printSearchInfo(int depth, int lineIndex);
 
-      return positionalEvaluation;
+    /**
+     * @brief Whether a color has any pieces other than pawns and the king (null move pruning is unsafe without them because of zugzwang)
+     * @param color The color to check
+     */
+    bool hasNonPawnMaterial(PieceColor color)
+    {
+      return board.bitboard(color | KNIGHT) | board.bitboard(color | BISHOP) | board.bitboard(color | ROOK) | board.bitboard(color | QUEEN);
     }
 
     /**
-     * @brief Generates a move from the integer representation, used for opening book parsing (see Move::toInt())
-     * @param moveInt The integer representation of the move
+     * @brief Generates the best move within the given search limits, see generateBotMove. The stop and ponder flags must already be set up
+     *        by the caller, so that a stop or ponder hit signalled right after starting an asynchronous search is not lost
+     * @param limits The limits of the search
      */
-    Move generateMoveFromInt(MoveInt moveInt);
+    Move searchBestMove(const SearchLimits &limits);
 
     /**
      * @brief Generates a move using a depth of 1 (not used unless the bot is set to depth 1)
@@ -116,33 +362,59 @@ namespace TungstenChess
     Move generateOneDeepMove();
 
     /**
-     * @brief Generates the best move for the bot
+     * @brief Generates the best move for the bot, using principal variation search. The score is stored in searchScore
+     *        (if it is outside of the window, it is only a bound and the returned move should not be trusted).
+     *        Root moves in excludedRootMoves are skipped, in which case the result is not stored in the transposition table
      * @param depth The depth to search to
-     * @param alpha The alpha value for alpha-beta pruning (should not be set outside of recursive calls)
-     * @param beta The beta value for alpha-beta pruning (should not be set outside of recursive calls)
+     * @param alpha The lower bound of the search window
+     * @param beta The upper bound of the search window
      */
     Move generateBestMove(int depth, int alpha = NEGATIVE_INFINITY, int beta = POSITIVE_INFINITY);
 
     /**
-     * @brief Uses iterative deepening to find the best move in a constant amount of time
-     * @param time The time in milliseconds to search for (this time is not exact, but the bot will stop after a search is complete AND the time has run out.
-     *             It will not stop in the middle of a search, so the actual time spent may be significantly longer than the time parameter)
-     * @param start The time the search started, used to check if the time has run out
+     * @brief Searches the root with an aspiration window centred on the score of the previous iteration, widening the window
+     *        on the failing side and searching again until the score falls inside it
+     * @param depth The depth to search to
+     * @param previousScore The score of the previous iteration
+     */
+    Move aspirationSearch(int depth, int previousScore);
+
+    /**
+     * @brief Uses iterative deepening to find the best move within a depth limit and the time allocated by the time manager.
+     *        No new iteration is started once the soft limit has passed (see TimeManager::canStartIteration). If the search is stopped
+     *        (see countNode and stopSearch), the current iteration is aborted and the best move from the last completed iteration is returned
+     * @param maxDepth The depth of the last iteration
      */
-    Move iterativeDeepening(int time, std::chrono::time_point<std::chrono::high_resolution_clock> start);
+    Move iterativeDeepening(int maxDepth);
 
     /**
-     * @brief Gets the static evaluation of the current position, from the perspective of the side to move
+     * @brief Runs the search on the main thread, with helper threads searching copies of the board in parallel (Lazy SMP)
+     *        The helpers only contribute through the shared transposition table, the result of the main thread is returned
+     * @param maxDepth The depth of the last iteration of the main thread
+     */
+    Move parallelSearch(int maxDepth);
+
+    /**
+     * @brief Iterative deepening search run by a helper thread until it is stopped by the main thread
+     * @param threadIndex The index of the helper thread (used to vary the starting depth between helpers)
+     */
+    void helperSearch(int threadIndex);
+
+    /**
+     * @brief Gets the static evaluation of the current position, from the perspective of the side to move. Does not generate moves,
+     *        so checkmate and stalemate are not detected here - the search detects them from the number of legal moves
      */
     int getStaticEvaluation();
 
     /**
      * @brief Gets the material evaluation of the current position, independent of the side to move (positive for white favor, negative for black favor)
+     *        Maintained incrementally by the board, see Board::materialEvaluation
      */
     int getMaterialEvaluation();
 
     /**
      * @brief Gets the positional evaluation of the current position, independent of the side to move (positive for white favor, negative for black favor)
+     *        The piece-square tables of all pieces except kings are maintained incrementally by the board, see Board::pieceSquareEvaluation
      */
     int getPositionalEvaluation();
 
@@ -152,31 +424,32 @@ namespace TungstenChess
     int getEvaluationBonus();
 
     /**
-     * @brief Negamax search with alpha-beta pruning and quiescence search
-     * @param depth The depth to search to
-     * @param alpha The alpha value for alpha-beta pruning
-     * @param beta The beta value for alpha-beta pruning
+     * @brief Gets the pawn structure evaluation (doubled, isolated and passed pawns) of the current position, independent of the side to move
+     *        Only depends on the pawns, so it is cached in the pawn hash table by pawn Zobrist key
+     * @return The pawn hash table entry for the current pawn structure
      */
-    int negamax(int depth, int alpha, int beta);
+    const PawnHashTableEntry &getPawnStructureEvaluation();
 
     /**
-     * @brief Quiescence search
+     * @brief Negamax search with alpha-beta pruning and quiescence search. Moves after the first are searched with a null window
+     *        around alpha (principal variation search), and only searched again with the full window if they fail high.
+     *        Null window nodes may be pruned by a reduced search after passing the turn (null move pruning), and late quiet moves
+     *        are searched to a reduced depth first (late move reductions), see BotSettings
      * @param depth The depth to search to
+     * @param ply The distance from the root of the search
      * @param alpha The alpha value for alpha-beta pruning
      * @param beta The beta value for alpha-beta pruning
+     * @param allowNullMove Whether null move pruning may be tried (false directly after a null move)
      */
-    int quiesce(int depth, int alpha, int beta);
-
-    /**
-     * @brief Heuristic evaluation of a move, used for move ordering to improve alpha-beta pruning
-     * @param move The move to evaluate
-     */
-    int heuristicEvaluation(Move move);
+    int negamax(int depth, int ply, int alpha, int beta, bool allowNullMove = true);
 
     /**
-     * @brief Sorts moves by heuristic evaluation (in place) to improve alpha-beta pruning
-     * @param moves The moves to sort
+     * @brief Quiescence search over captures that do not lose material, or over all evasions when in check (so that checkmate is detected)
+     * @param depth The depth to search to
+     * @param ply The distance from the root of the search
+     * @param alpha The alpha value for alpha-beta pruning
+     * @param beta The beta value for alpha-beta pruning
      */
-    void heuristicSortMoves(std::vector<Move> &moves);
+    int quiesce(int depth, int ply, int alpha, int beta);
   };
 }
\ No newline at end of file
@@ -24,6 +24,9 @@ namespace TungstenChess
     std::array<Bitboard, 64> BISHOP_MASKS;
     std::array<Bitboard, 64> ROOK_MASKS;
 
+    std::array<std::array<Bitboard, 64>, 64> BETWEEN_SQUARES; // Squares strictly between two squares on the same rank, file or diagonal, 0 otherwise
+    std::array<std::array<Bitboard, 64>, 64> LINE_SQUARES;    // The full rank, file or diagonal through two squares, 0 if they are not aligned
+
     std::array<std::array<Bitboard, 64>, BLACK_PAWN + 1> PAWN_CAPTURE_MOVES;
     std::array<std::array<Bitboard, 64>, BLACK_PAWN + 1> PAWN_REVERSE_SINGLE_MOVES;
     std::array<std::array<Bitboard, 64>, BLACK_PAWN + 1> PAWN_REVERSE_DOUBLE_MOVES;
@@ -39,6 +42,48 @@ namespace TungstenChess
       initPawnMoves();
       initBishopMasks();
       initRookMasks();
+      initLineTables();
+    }
+
+    /**
+     * @brief Initializes the between and line lookup tables (used for check evasions and pins)
+     */
+    void initLineTables()
+    {
+      for (auto &table : BETWEEN_SQUARES)
+        table.fill(0);
+      for (auto &table : LINE_SQUARES)
+        table.fill(0);
+
+      int rankSteps[8] = {-1, -1, -1, 0, 0, 1, 1, 1};
+      int fileSteps[8] = {-1, 0, 1, -1, 1, -1, 0, 1};
+
+      for (int square = 0; square < 64; square++)
+      {
+        for (int i = 0; i < 8; i++)
+        {
+          // The full line through the square in this direction, including the opposite direction (at index 7 - i)
+          Bitboard line = 1ULL << square;
+
+          for (int direction : {i, 7 - i})
+            for (int rank = square / 8 + rankSteps[direction], file = square % 8 + fileSteps[direction];
+                 rank >= 0 && rank <= 7 && file >= 0 && file <= 7; rank += rankSteps[direction], file += fileSteps[direction])
+              line |= 1ULL << (rank * 8 + file);
+
+          Bitboard between = 0;
+
+          for (int rank = square / 8 + rankSteps[i], file = square % 8 + fileSteps[i];
+               rank >= 0 && rank <= 7 && file >= 0 && file <= 7; rank += rankSteps[i], file += fileSteps[i])
+          {
+            int to = rank * 8 + file;
+
+            BETWEEN_SQUARES[square][to] = between;
+            LINE_SQUARES[square][to] = line;
+
+            between |= 1ULL << to;
+          }
+        }
+      }
     }
 
     /**
@@ -0,0 +1,284 @@
+#pragma once
+
+#include <array>
+#include <algorithm>
+
+#include "board.hpp"
+#include "piece_eval_tables.hpp"
+#include "search_history.hpp"
+
+namespace TungstenChess
+{
+  class MovePicker
+  {
+  public:
+    /**
+     * @param board The board to pick moves for (moves are picked for the side to move)
+     * @param hashMove The best move stored in the transposition table, if any (see Move::toInt())
+     * @param searchHistory The killer moves, history scores and countermoves used to order quiet moves
+     * @param ply The distance from the root of the search, used to look up killer moves
+     * @param onlyCaptures Whether to only pick captures that do not lose material (used for quiescence search)
+     */
+    MovePicker(Board &board, MoveInt hashMove, const SearchHistory &searchHistory, int ply, bool onlyCaptures = false)
+        : board(board), searchHistory(searchHistory), hashMove(hashMove), onlyCaptures(onlyCaptures), stage(HASH_MOVE_STAGE)
+    {
+      if (!onlyCaptures)
+      {
+        refutations[0] = searchHistory.killerMove(ply, 0);
+        refutations[1] = searchHistory.killerMove(ply, 1);
+        refutations[2] = searchHistory.countermove(board.lastMove());
+      }
+    }
+
+    /**
+     * @brief Gets the next move, in order of the stages (hash move, good captures, killer moves and countermove, quiet moves, bad captures). Each stage is only
+     *        generated once the previous stage is exhausted, and moves within a stage are picked by selection sort on scores that are computed once per move
+     * @param move The move to set
+     * @return Whether a move was found - if false, all legal moves have been picked
+     */
+    bool nextMove(Move &move)
+    {
+      while (true)
+      {
+        switch (stage)
+        {
+        case HASH_MOVE_STAGE:
+          stage = GENERATE_CAPTURES_STAGE;
+
+          if (isValidHashMove(move) && (!onlyCaptures || isGoodCapture(move)))
+            return true;
+
+          hashMove = NULL_MOVE;
+          break;
+
+        case GENERATE_CAPTURES_STAGE:
+          moves = board.getLegalMoves(board.sideToMove(), CAPTURE_MOVES);
+          scoreCaptures();
+          stage = CAPTURES_STAGE;
+          break;
+
+        case CAPTURES_STAGE:
+          while (pickBestMove(move))
+          {
+            if (isGoodCapture(move))
+              return true;
+
+            badCaptures.push_back(move);
+          }
+
+          stage = onlyCaptures ? DONE_STAGE : REFUTATIONS_STAGE;
+          break;
+
+        case REFUTATIONS_STAGE:
+          while (refutationIndex < refutations.size())
+          {
+            MoveInt &refutation = refutations[refutationIndex++];
+
+            if (isValidRefutation(refutation, move))
+              return true;
+
+            refutation = NULL_MOVE;
+          }
+
+          stage = GENERATE_QUIETS_STAGE;
+          break;
+
+        case GENERATE_QUIETS_STAGE:
+          moves = board.getLegalMoves(board.sideToMove(), QUIET_MOVES);
+          scoreQuiets();
+          stage = QUIETS_STAGE;
+          break;
+
+        case QUIETS_STAGE:
+          if (pickBestMove(move))
+            return true;
+
+          stage = BAD_CAPTURES_STAGE;
+          break;
+
+        case BAD_CAPTURES_STAGE:
+          if (badCaptureIndex < badCaptures.size())
+          {
+            move = badCaptures[badCaptureIndex++];
+            return true;
+          }
+
+          stage = DONE_STAGE;
+          break;
+
+        case DONE_STAGE:
+          return false;
+        }
+      }
+    }
+
+  private:
+    enum Stages
+    {
+      HASH_MOVE_STAGE,
+      GENERATE_CAPTURES_STAGE,
+      CAPTURES_STAGE,
+      REFUTATIONS_STAGE,
+      GENERATE_QUIETS_STAGE,
+      QUIETS_STAGE,
+      BAD_CAPTURES_STAGE,
+      DONE_STAGE
+    };
+
+    Board &board;
+    const SearchHistory &searchHistory;
+
+    MoveInt hashMove;
+    bool onlyCaptures;
+
+    int stage;
+
+    std::array<MoveInt, 3> refutations = {NULL_MOVE, NULL_MOVE, NULL_MOVE}; // Killer moves and countermove, picked before the other quiet moves
+    size_t refutationIndex = 0;
+
+    MoveList moves;
+    std::array<int, MAX_MOVES> scores;
+    size_t nextIndex = 0;
+
+    MoveList badCaptures; // Captures that lose material (see Board::see), picked after the quiet moves and never picked when only picking captures
+    size_t badCaptureIndex = 0;
+
+    /**
+     * @brief Checks that the hash move is legal in the current position (the entry may come from a Zobrist key collision)
+     * @param move The move to set to the hash move, if it is valid
+     */
+    bool isValidHashMove(Move &move)
+    {
+      return isLegalMove(hashMove, move);
+    }
+
+    /**
+     * @brief Checks that a killer move or countermove is a legal quiet move in the current position that has not been picked yet
+     * @param refutation The move to check, see Move::toInt()
+     * @param move The move to set to the refutation, if it is valid
+     */
+    bool isValidRefutation(MoveInt refutation, Move &move)
+    {
+      if (refutation == hashMove || (board[(refutation >> 6) & 0x3F] & (board.sideToMove() ^ COLOR)))
+        return false;
+
+      for (size_t i = 0; i + 1 < refutationIndex; i++)
+        if (refutations[i] == refutation)
+          return false;
+
+      return isLegalMove(refutation, move);
+    }
+
+    /**
+     * @brief Checks whether a move stored from another position is legal in the current position
+     * @param moveInt The move to check, see Move::toInt()
+     * @param move The move to set, if it is legal
+     */
+    bool isLegalMove(MoveInt moveInt, Move &move)
+    {
+      if (moveInt == NULL_MOVE)
+        return false;
+
+      int from = moveInt & 0x3F;
+      int to = (moveInt >> 6) & 0x3F;
+      PieceType promotionPieceType = (moveInt >> 12) & 0x7;
+
+      if (!(board[from] & board.sideToMove()))
+        return false;
+
+      if (onlyCaptures && !(board[to] & (board.sideToMove() ^ COLOR)))
+        return false;
+
+      if (!Bitboards::hasBit(board.getLegalPieceMovesBitboard(from), to))
+        return false;
+
+      move = board.generateMove(from, to, promotionPieceType);
+
+      if ((move.flags() & PROMOTION) ? (promotionPieceType < KNIGHT || promotionPieceType > QUEEN) : promotionPieceType != EMPTY)
+        return false;
+
+      return true;
+    }
+
+    /**
+     * @brief Checks whether a capture does not lose material. Captures of a piece at least as valuable as the capturing piece
+     *        are always good, so the static exchange evaluation is only needed for the others
+     * @param move The capture to check
+     */
+    bool isGoodCapture(Move move)
+    {
+      if (PIECE_VALUES[board[move.to()] & TYPE] >= PIECE_VALUES[board[move.from()] & TYPE])
+        return true;
+
+      return board.see(move) >= 0;
+    }
+
+    /**
+     * @brief Scores captures by most valuable victim, then least valuable attacker (MVV-LVA)
+     */
+    void scoreCaptures()
+    {
+      for (size_t i = 0; i < moves.size(); i++)
+      {
+        Move move = moves[i];
+
+        scores[i] = PIECE_VALUES[board[move.to()] & TYPE] * 10 - PIECE_VALUES[board[move.from()] & TYPE] + PIECE_VALUES[move.promotionPieceType()];
+      }
+
+      nextIndex = 0;
+    }
+
+    /**
+     * @brief Scores quiet moves by history score, then by the change in piece-square table value (and the value of the promotion piece, if any)
+     */
+    void scoreQuiets()
+    {
+      for (size_t i = 0; i < moves.size(); i++)
+      {
+        Move move = moves[i];
+        Piece piece = board[move.from()];
+
+        scores[i] = searchHistory.historyScore(board.sideToMove(), move.from(), move.to()) +
+                    PIECE_EVAL_TABLES[piece][move.to()] - PIECE_EVAL_TABLES[piece][move.from()] + PIECE_VALUES[move.promotionPieceType()];
+      }
+
+      nextIndex = 0;
+    }
+
+    /**
+     * @brief Picks the highest scoring remaining move in the current stage (selection sort), skipping moves that were already picked
+     *        in an earlier stage. Refutations are only skipped among the quiet moves: they are not validated before the captures
+     *        stage, and a stale killer can share its squares with a capture
+     * @param move The move to set
+     * @return Whether a move was found
+     */
+    bool pickBestMove(Move &move)
+    {
+      while (nextIndex < moves.size())
+      {
+        size_t bestIndex = nextIndex;
+
+        for (size_t i = nextIndex + 1; i < moves.size(); i++)
+          if (scores[i] > scores[bestIndex])
+            bestIndex = i;
+
+        std::swap(moves[nextIndex], moves[bestIndex]);
+        std::swap(scores[nextIndex], scores[bestIndex]);
+
+        move = moves[nextIndex++];
+
+        MoveInt moveInt = move.toInt();
+
+        if (moveInt == hashMove)
+          continue;
+
+        if (stage == QUIETS_STAGE && (moveInt == refutations[0] || moveInt == refutations[1] || moveInt == refutations[2]))
+          continue;
+
+        return true;
+      }
+
+      return false;
+    }
+  };
+}
\ No newline at end of file
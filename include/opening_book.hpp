@@ -1,138 +1,164 @@
 #pragma once
 
-#include <vector>
-#include <fstream>
+#include <string>
+#include <cstdint>
+#include <cstdlib>
+#include <algorithm>
+#include <utility>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
-#define NULL_MOVE 0
+#include "board.hpp"
+
+#define OPENING_BOOK_MAGIC 0x314B4F4F424E5754ULL // "TWNBOOK1" in little endian, the first 8 bytes of a book file
 
 namespace TungstenChess
 {
-  typedef uint16_t MoveInt;
+  /**
+   * A book file is an OpeningBookHeader followed by entryCount entries sorted by key, so the moves of a position are adjacent
+   * and can be found with a binary search. Positions are identified by their Zobrist key (see Board::zobristKey()), so a book
+   * only matches the Zobrist keys it was generated with
+   */
+  struct OpeningBookHeader
+  {
+    uint64_t magic;
+    uint64_t entryCount;
+  };
+
+  struct OpeningBookEntry
+  {
+    ZobristKey key;
+    MoveInt move;    // See Move::toInt()
+    uint16_t weight; // Relative frequency of the move in the position
+    uint32_t padding;
+  };
+
+  static_assert(sizeof(OpeningBookHeader) == 16 && sizeof(OpeningBookEntry) == 16, "Opening book records must match the file format");
 
   class OpeningBook
   {
   public:
-    bool inOpeningBook = true;
+    OpeningBook() = default;
+    OpeningBook(const OpeningBook &) = delete;
+    OpeningBook &operator=(const OpeningBook &) = delete;
+
+    ~OpeningBook() { unloadOpeningBook(); }
 
     /**
-     * @brief Loads the opening book from a file
+     * @brief Memory maps an opening book file, so no entries are read until they are probed
      * @param path The path to the opening book file
-     * @param openingBookSize The number of entries in the opening book (i.e. the size of the file in bytes divided by 4)
+     * @return Whether the file is a valid opening book (if not, no book is loaded)
      */
-    void loadOpeningBook(const std::string &path, uint openingBookSize)
+    bool loadOpeningBook(const std::string &path)
     {
-      std::ifstream file(path);
+      unloadOpeningBook();
 
-      openingBook.resize(openingBookSize);
+      int fd = open(path.c_str(), O_RDONLY);
+      if (fd < 0)
+        return false;
 
-      // read the file 4 bytes at a time into the book array
-      for (size_t i = 0; i < openingBookSize; i++)
+      struct stat fileStat;
+      if (fstat(fd, &fileStat) < 0 || (size_t)fileStat.st_size < sizeof(OpeningBookHeader))
       {
-        file.read((char *)&openingBook[i], sizeof(uint));
+        close(fd);
+        return false;
       }
 
-      file.close();
-    }
+      void *data = mmap(nullptr, fileStat.st_size, PROT_READ, MAP_SHARED, fd, 0);
+      close(fd);
 
-    /**
-     * @brief Updates move history to synchronize with given vector
-     * @param moves The moves to update the history with
-     */
-    void updateMoveHistory(const std::vector<MoveInt> &newMoves)
-    {
-      for (size_t i = moves.size(); i < newMoves.size() && inOpeningBook; i++)
-      {
-        inOpeningBook = addMove(newMoves[i]);
-      }
-    }
+      if (data == MAP_FAILED)
+        return false;
 
-    /**
-     * @brief Adds a move to the move history
-     * @param move The move to add
-     * @return Whether the move was added successfully - if false, the move is not in the opening book
-     */
-    bool addMove(MoveInt move)
-    {
-      for (int i = lastMoveIndex + 1;; i++)
+      const OpeningBookHeader *header = (const OpeningBookHeader *)data;
+      size_t maxEntries = (fileStat.st_size - sizeof(OpeningBookHeader)) / sizeof(OpeningBookEntry);
+
+      if (header->magic != OPENING_BOOK_MAGIC || header->entryCount > maxEntries)
       {
-        if (openingBook[i] >> 25 == moves.size() - 1)
-        {
-          return false;
-        }
-        if ((openingBook[i] & 0xFFF) == move && openingBook[i] >> 25 == moves.size())
-        {
-          lastMoveIndex = i;
-          break;
-        }
+        munmap(data, fileStat.st_size);
+        return false;
       }
 
-      moves.push_back(move);
+      // Probes jump around the file, so read ahead would only load pages that are never used
+      madvise(data, fileStat.st_size, MADV_RANDOM);
+
+      mappedData = data;
+      mappedSize = fileStat.st_size;
+      entries = (const OpeningBookEntry *)(header + 1);
+      entryCount = header->entryCount;
 
       return true;
     }
 
     /**
-     * @brief Gets the next move from the opening book, randomly selected weighted by the frequency of the moves
+     * @brief Unmaps the opening book file, if one is loaded
      */
-    MoveInt getNextMove() const { return getWeightedRandomMove(); }
-
-  private:
-    std::vector<uint> openingBook;
-
-    std::vector<MoveInt> moves;
-
-    int lastMoveIndex = -1;
-
-    /**
-     * @brief Gets the next possible "children" moves from the opening book
-     */
-    std::vector<MoveInt> getChildrenMoves() const
+    void unloadOpeningBook()
     {
-      std::vector<MoveInt> childrenMoves;
-
-      for (size_t i = lastMoveIndex + 1; i < openingBook.size(); i++)
-      {
-        if (openingBook[i] >> 25 == moves.size())
-          childrenMoves.push_back(openingBook[i] & 0xFFF);
-        else if (openingBook[i] >> 25 == moves.size() - 1)
-          break;
-      }
+      if (mappedData)
+        munmap(mappedData, mappedSize);
 
-      return childrenMoves;
+      mappedData = nullptr;
+      mappedSize = 0;
+      entries = nullptr;
+      entryCount = 0;
     }
 
+    bool isLoaded() const { return entryCount > 0; }
+
     /**
-     * @brief Gets a random next move, weighted by the frequency of the children moves
+     * @brief Gets a book move for a position, randomly selected weighted by the frequency of the moves
+     * @param key The Zobrist key of the position
+     * @return The move (see Move::toInt()), or NULL_MOVE if the position is not in the book
      */
-    MoveInt getWeightedRandomMove() const
+    MoveInt getMove(ZobristKey key) const
     {
-      std::vector<MoveInt> childrenMoves = getChildrenMoves();
-
-      if (childrenMoves.size() == 0)
-        return NULL_MOVE;
+      auto [first, last] = getEntries(key);
 
       int totalWeight = 0;
+      for (const OpeningBookEntry *entry = first; entry != last; entry++)
+        totalWeight += entry->weight;
 
-      for (size_t i = 0; i < childrenMoves.size(); i++)
-      {
-        totalWeight += openingBook[lastMoveIndex + 1 + i] >> 12 & 0x1FFF;
-      }
+      if (totalWeight == 0)
+        return NULL_MOVE;
 
       int randomWeight = rand() % totalWeight;
-
       int currentWeight = 0;
 
-      for (size_t i = 0; i < childrenMoves.size(); i++)
+      for (const OpeningBookEntry *entry = first; entry != last; entry++)
       {
-        currentWeight += openingBook[lastMoveIndex + 1 + i] >> 12 & 0x1FFF;
+        currentWeight += entry->weight;
 
         if (currentWeight > randomWeight)
-        {
-          return childrenMoves[i];
-        }
+          return entry->move;
       }
 
-      return 0;
+      return NULL_MOVE;
+    }
+
+    /**
+     * @brief Gets the entries of a position with a binary search, so probing takes O(log n) time in the size of the book
+     * @param key The Zobrist key of the position
+     * @return The range of entries, which is empty if the position is not in the book
+     */
+    std::pair<const OpeningBookEntry *, const OpeningBookEntry *> getEntries(ZobristKey key) const
+    {
+      return std::equal_range(entries, entries + entryCount, key, EntryKeyCompare());
     }
+
+  private:
+    struct EntryKeyCompare
+    {
+      bool operator()(const OpeningBookEntry &entry, ZobristKey key) const { return entry.key < key; }
+      bool operator()(ZobristKey key, const OpeningBookEntry &entry) const { return key < entry.key; }
+    };
+
+    void *mappedData = nullptr;
+    size_t mappedSize = 0;
+
+    const OpeningBookEntry *entries = nullptr;
+    uint64_t entryCount = 0;
   };
 }
\ No newline at end of file
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <vector>
+
+#include "bitboard.hpp"
+#include "zobrist.hpp"
+
+#define PAWN_HASH_TABLE_ENTRIES 32768 // Must be a power of two
+
+namespace TungstenChess
+{
+  struct PawnHashTableEntry
+  {
+    ZobristKey key;
+    int score;                 // Pawn structure evaluation, positive for white favor
+    Bitboard whitePassedPawns; // White pawns on files counted as passed
+    Bitboard blackPassedPawns; // Black pawns on files counted as passed
+  };
+
+  /**
+   * Caches the pawn structure evaluation by pawn Zobrist key (see Board::pawnZobristKey). Not thread safe, each search thread has its own table
+   */
+  class PawnHashTable
+  {
+  public:
+    PawnHashTable() : entries(PAWN_HASH_TABLE_ENTRIES, {0, 0, 0, 0}) {}
+
+    /**
+     * @brief Looks up a pawn structure in the table
+     * @param key The pawn Zobrist key of the position
+     * @return The entry if the pawn structure was found, otherwise nullptr
+     */
+    const PawnHashTableEntry *probe(ZobristKey key) const
+    {
+      const PawnHashTableEntry &entry = entries[key & (PAWN_HASH_TABLE_ENTRIES - 1)];
+
+      return entry.key == key ? &entry : nullptr;
+    }
+
+    /**
+     * @brief Stores a pawn structure in the table, always replacing the previous entry
+     * @param entry The entry to store
+     * @return The stored entry
+     */
+    const PawnHashTableEntry &store(const PawnHashTableEntry &entry)
+    {
+      return entries[entry.key & (PAWN_HASH_TABLE_ENTRIES - 1)] = entry;
+    }
+
+  private:
+    std::vector<PawnHashTableEntry> entries;
+  };
+}
\ No newline at end of file
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <array>
+#include <cmath>
+#include <algorithm>
+
+namespace TungstenChess
+{
+  class LateMoveReductions
+  {
+  public:
+    /**
+     * @brief Get the instance of the LateMoveReductions singleton
+     * @return LateMoveReductions&
+     */
+    static LateMoveReductions &getInstance()
+    {
+      static LateMoveReductions instance;
+      return instance;
+    }
+
+    /**
+     * @brief Gets the number of plies to reduce a late move by
+     * @param depth The remaining depth of the search
+     * @param moveNumber The number of moves searched before this one, including this one
+     */
+    int get(int depth, int moveNumber) const
+    {
+      return reductions[std::min(depth, TABLE_SIZE - 1)][std::min(moveNumber, TABLE_SIZE - 1)];
+    }
+
+  private:
+    static constexpr int TABLE_SIZE = 64;
+
+    std::array<std::array<int, TABLE_SIZE>, TABLE_SIZE> reductions;
+
+    /**
+     * @brief Populates the reduction table, which grows with the logarithm of both the depth and the move number
+     */
+    LateMoveReductions()
+    {
+      for (int depth = 0; depth < TABLE_SIZE; depth++)
+        for (int moveNumber = 0; moveNumber < TABLE_SIZE; moveNumber++)
+          reductions[depth][moveNumber] = depth && moveNumber ? (int)(0.75 + std::log(depth) * std::log(moveNumber) / 2.25) : 0;
+    }
+  };
+}
\ No newline at end of file
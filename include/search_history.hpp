@@ -0,0 +1,124 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+#include "board.hpp"
+
+#define MAX_KILLER_PLY 128
+#define MAX_HISTORY_SCORE 1000000 // Once a history score reaches this, the whole table is halved to keep scores bounded
+
+namespace TungstenChess
+{
+  /**
+   * Move ordering statistics gathered from beta cutoffs during a search, used to order quiet moves (see MovePicker)
+   */
+  class SearchHistory
+  {
+  public:
+    SearchHistory()
+    {
+      clear();
+    }
+
+    /**
+     * @brief Clears all killer moves, history scores and countermoves
+     */
+    void clear()
+    {
+      for (auto &killers : killerMoves)
+        killers.fill(NULL_MOVE);
+
+      for (auto &fromTable : historyScores)
+        for (auto &toTable : fromTable)
+          toTable.fill(0);
+
+      for (auto &countermoves : countermoveTable)
+        countermoves.fill(NULL_MOVE);
+    }
+
+    /**
+     * @brief Prepares the tables for a new search: killer moves are cleared since they are specific to a ply of the last search,
+     *        and history scores are halved so that they favor recent searches
+     */
+    void age()
+    {
+      for (auto &killers : killerMoves)
+        killers.fill(NULL_MOVE);
+
+      halveHistoryScores();
+    }
+
+    /**
+     * @brief Updates the tables after a quiet move caused a beta cutoff
+     * @param color The color that made the move
+     * @param move The move that caused the cutoff, see Move::toInt()
+     * @param ply The distance from the root of the search
+     * @param depth The remaining depth of the search (deeper cutoffs are weighted more heavily)
+     * @param previousMove The move played before the cutoff move, or NULL_MOVE if there is none
+     */
+    void updateCutoff(PieceColor color, MoveInt move, int ply, int depth, MoveInt previousMove)
+    {
+      if (ply < MAX_KILLER_PLY && killerMoves[ply][0] != move)
+      {
+        killerMoves[ply][1] = killerMoves[ply][0];
+        killerMoves[ply][0] = move;
+      }
+
+      int &historyScore = historyScores[colorIndex(color)][move & 0x3F][(move >> 6) & 0x3F];
+
+      historyScore += depth * depth;
+
+      if (historyScore >= MAX_HISTORY_SCORE)
+        halveHistoryScores();
+
+      if (previousMove != NULL_MOVE)
+        countermoveTable[previousMove & 0x3F][(previousMove >> 6) & 0x3F] = move;
+    }
+
+    /**
+     * @brief Gets a killer move for a ply, or NULL_MOVE if there is none
+     * @param ply The distance from the root of the search
+     * @param slot The killer slot (0 for the most recent killer, 1 for the one before)
+     */
+    MoveInt killerMove(int ply, int slot) const
+    {
+      return ply < MAX_KILLER_PLY ? killerMoves[ply][slot] : NULL_MOVE;
+    }
+
+    /**
+     * @brief Gets the move that most recently refuted a move, or NULL_MOVE if there is none
+     * @param previousMove The move to get the refutation of, see Move::toInt()
+     */
+    MoveInt countermove(MoveInt previousMove) const
+    {
+      return previousMove == NULL_MOVE ? NULL_MOVE : countermoveTable[previousMove & 0x3F][(previousMove >> 6) & 0x3F];
+    }
+
+    /**
+     * @brief Gets the history score of a move (the sum of squared depths of the cutoffs it caused, halved with age)
+     * @param color The color making the move
+     * @param from The square the move is from
+     * @param to The square the move is to
+     */
+    int historyScore(PieceColor color, int from, int to) const
+    {
+      return historyScores[colorIndex(color)][from][to];
+    }
+
+  private:
+    std::array<std::array<MoveInt, 2>, MAX_KILLER_PLY> killerMoves;
+    std::array<std::array<std::array<int, 64>, 64>, 2> historyScores;
+    std::array<std::array<MoveInt, 64>, 64> countermoveTable;
+
+    static int colorIndex(PieceColor color) { return color == WHITE ? 0 : 1; }
+
+    void halveHistoryScores()
+    {
+      for (auto &fromTable : historyScores)
+        for (auto &toTable : fromTable)
+          for (int &score : toTable)
+            score /= 2;
+    }
+  };
+}
\ No newline at end of file
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <array>
+#include <algorithm>
+#include <cstdint>
+
+#include "board.hpp"
+
+#define MOVE_OVERHEAD 10          // In milliseconds, kept in reserve on the clock for communication delays
+#define DEFAULT_MOVES_TO_GO 30    // Moves the remaining time is split over when the time control has no moves to go (or more than this)
+#define HARD_LIMIT_SCALE 4        // The hard limit is at most this many times the soft limit
+#define MAX_CLOCK_USAGE 0.5       // The hard limit never exceeds this fraction of the remaining time, leaving a margin for delays in the GUI or network
+#define MAX_SOFT_CLOCK_USAGE 0.25 // No iteration is started after this fraction of the remaining time, even with an unstable best move
+#define MISSING_CLOCK_TIME 100    // In milliseconds, the budget when a clock is given for the opponent only (the own clock is missing or 0)
+
+namespace TungstenChess
+{
+  /**
+   * The limits of a search, as given by the UCI "go" command. Times are in milliseconds, and 0 means the limit was not given
+   */
+  struct SearchLimits
+  {
+    int whiteTime = 0;
+    int blackTime = 0;
+    int whiteIncrement = 0;
+    int blackIncrement = 0;
+    int movesToGo = 0;
+    int moveTime = 0;
+    int depth = 0;
+    uint64_t nodes = 0;
+    bool infinite = false;
+    bool ponder = false; // The time limits only start to apply once the ponder move is played, see Bot::ponderHit
+  };
+
+  /**
+   * Allocates the time of a search from the limits. The soft limit is checked between iterative deepening iterations, and is
+   * scaled by how often the best move changed in the last iterations: an unstable best move gets more time, a stable one less.
+   * The hard limit aborts the search mid-iteration
+   */
+  class TimeManager
+  {
+  public:
+    /**
+     * @brief Allocates the time of a new search
+     * @param limits The limits of the search
+     * @param color The color to move
+     */
+    void init(const SearchLimits &limits, PieceColor color)
+    {
+      softLimit = 0;
+      hardLimit = 0;
+      maxSoftLimit = 0;
+      useStability = false;
+
+      bestMove = NULL_MOVE;
+      stability = 0;
+
+      int time = color == WHITE ? limits.whiteTime : limits.blackTime;
+      int increment = color == WHITE ? limits.whiteIncrement : limits.blackIncrement;
+
+      if (limits.infinite)
+        return;
+
+      if (limits.moveTime)
+      {
+        softLimit = hardLimit = limits.moveTime;
+        return;
+      }
+
+      if (!time)
+      {
+        // Without any clock the search is only limited by depth or nodes, but a clock based search must not run forever
+        if (limits.whiteTime || limits.blackTime)
+          softLimit = hardLimit = MISSING_CLOCK_TIME;
+        return;
+      }
+
+      int available = std::max(time - MOVE_OVERHEAD, 1);
+      int movesToGo = limits.movesToGo ? std::min(limits.movesToGo, DEFAULT_MOVES_TO_GO) : DEFAULT_MOVES_TO_GO;
+
+      softLimit = available / movesToGo + increment * 3 / 4;
+      hardLimit = std::max(std::min(softLimit * HARD_LIMIT_SCALE, (int)(available * MAX_CLOCK_USAGE)), 1);
+      softLimit = std::clamp(softLimit, 1, hardLimit);
+      maxSoftLimit = std::max((int)(available * MAX_SOFT_CLOCK_USAGE), 1);
+
+      useStability = true;
+    }
+
+    /**
+     * @brief Gets the time in milliseconds after which the search is aborted, or 0 for no limit
+     */
+    int getHardLimit() const { return hardLimit; }
+
+    /**
+     * @brief Records the best move of a completed iteration
+     * @param move The best move of the iteration, see Move::toInt()
+     */
+    void updateBestMove(MoveInt move)
+    {
+      stability = move == bestMove ? std::min(stability + 1, MAX_STABILITY) : 0;
+      bestMove = move;
+    }
+
+    /**
+     * @brief Whether another iteration should be started
+     * @param elapsed The time in milliseconds since the search started
+     */
+    bool canStartIteration(int elapsed) const
+    {
+      if (!softLimit)
+        return true;
+
+      if (!useStability)
+        return elapsed < softLimit;
+
+      // The cap applies after the stability scale, so that few moves to go with an unstable best move cannot use most of the clock
+      return elapsed < std::min(softLimit * STABILITY_SCALES[stability], (double)maxSoftLimit);
+    }
+
+  private:
+    static constexpr int MAX_STABILITY = 4;
+
+    // Soft limit scale by the number of consecutive iterations the best move stayed the same
+    static constexpr std::array<double, MAX_STABILITY + 1> STABILITY_SCALES = {2.0, 1.4, 1.0, 0.8, 0.6};
+
+    int softLimit = 0;
+    int hardLimit = 0;
+    int maxSoftLimit = 0;      // Cap on the scaled soft limit, only used with clock based limits
+    bool useStability = false; // Only clock based limits are scaled, a fixed move time is always used in full
+
+    MoveInt bestMove = NULL_MOVE;
+    int stability = 0;
+  };
+}
\ No newline at end of file
@@ -0,0 +1,170 @@
+#pragma once
+
+#include <vector>
+#include <atomic>
+#include <algorithm>
+#include <cstdint>
+
+#include "zobrist.hpp"
+
+namespace TungstenChess
+{
+  typedef uint16_t MoveInt;
+
+  enum TranspositionTableBound
+  {
+    EXACT_BOUND = 0,
+    LOWER_BOUND = 1,
+    UPPER_BOUND = 2,
+  };
+
+  struct TranspositionTableEntry
+  {
+    int score;
+    MoveInt bestMove; // See Move::toInt()
+    int8_t depth;
+    uint8_t bound;
+  };
+
+  class TranspositionTable
+  {
+  public:
+    /**
+     * @param sizeInMB The size of the table in megabytes (rounded down to a power of two number of entries)
+     */
+    TranspositionTable(int sizeInMB)
+    {
+      resize(sizeInMB);
+    }
+
+    /**
+     * @brief Resizes the table, clearing all entries. Must not be called while a search is running
+     * @param sizeInMB The new size of the table in megabytes (rounded down to a power of two number of entries)
+     */
+    void resize(int sizeInMB)
+    {
+      size_t maxEntries = (size_t)std::max(sizeInMB, 1) * 1024 * 1024 / sizeof(PackedEntry);
+
+      size_t numEntries = 1;
+      while (numEntries * 2 <= maxEntries)
+        numEntries *= 2;
+
+      entries = std::vector<PackedEntry>(numEntries);
+      indexMask = numEntries - 1;
+      sizeMB = sizeInMB;
+
+      clear();
+    }
+
+    /**
+     * @brief Clears all entries in the table. Must not be called while a search is running
+     */
+    void clear()
+    {
+      for (PackedEntry &entry : entries)
+      {
+        entry.keyXorData.store(0, std::memory_order_relaxed);
+        entry.data.store(0, std::memory_order_relaxed);
+      }
+    }
+
+    /**
+     * @brief Returns the size the table was created with, in megabytes
+     */
+    int size() const { return sizeMB; }
+
+    /**
+     * @brief Estimates how full the table is in permille (as reported by UCI "hashfull"), by sampling the first 1000 entries
+     */
+    int hashfull() const
+    {
+      size_t sampleSize = std::min(entries.size(), (size_t)1000);
+      size_t usedEntries = 0;
+
+      for (size_t i = 0; i < sampleSize; i++)
+        if (entries[i].keyXorData.load(std::memory_order_relaxed) | entries[i].data.load(std::memory_order_relaxed))
+          usedEntries++;
+
+      return usedEntries * 1000 / sampleSize;
+    }
+
+    /**
+     * @brief Looks up a position in the table. Safe to call concurrently with other probes and stores
+     * @param key The Zobrist key of the position
+     * @param entry The entry to copy the stored data into, only valid if the function returns true
+     * @return Whether the position was found
+     */
+    bool probe(ZobristKey key, TranspositionTableEntry &entry) const
+    {
+      const PackedEntry &storedEntry = entries[key & indexMask];
+
+      uint64_t data = storedEntry.data.load(std::memory_order_relaxed);
+
+      // An entry torn by a concurrent store fails this check and is treated as a miss
+      if ((storedEntry.keyXorData.load(std::memory_order_relaxed) ^ data) != key)
+        return false;
+
+      entry = unpack(data);
+
+      return true;
+    }
+
+    /**
+     * @brief Stores a position in the table. Entries for other positions are always replaced, while entries for the same position
+     *        are only replaced if the new search was at least as deep. Safe to call concurrently with other probes and stores
+     * @param key The Zobrist key of the position
+     * @param depth The depth the position was searched to
+     * @param score The score of the position
+     * @param bound Whether the score is exact or a bound, see enum TranspositionTableBound
+     * @param bestMove The best move found in the position, or NULL_MOVE if there is none
+     */
+    void store(ZobristKey key, int depth, int score, TranspositionTableBound bound, MoveInt bestMove)
+    {
+      PackedEntry &storedEntry = entries[key & indexMask];
+
+      uint64_t storedData = storedEntry.data.load(std::memory_order_relaxed);
+
+      if ((storedEntry.keyXorData.load(std::memory_order_relaxed) ^ storedData) == key && unpack(storedData).depth > depth)
+        return;
+
+      uint64_t data = pack(depth, score, bound, bestMove);
+
+      storedEntry.keyXorData.store(key ^ data, std::memory_order_relaxed);
+      storedEntry.data.store(data, std::memory_order_relaxed);
+    }
+
+  private:
+    /**
+     * Entries are stored as the packed data and the key XORed with the data, so that a probe can detect an entry
+     * that was partially overwritten by another thread without any locking
+     */
+    struct PackedEntry
+    {
+      std::atomic<uint64_t> keyXorData;
+      std::atomic<uint64_t> data;
+    };
+
+    std::vector<PackedEntry> entries;
+
+    size_t indexMask;
+
+    int sizeMB;
+
+    static uint64_t pack(int depth, int score, TranspositionTableBound bound, MoveInt bestMove)
+    {
+      return (uint64_t)(uint32_t)score | ((uint64_t)bestMove << 32) | ((uint64_t)(uint8_t)depth << 48) | ((uint64_t)bound << 56);
+    }
+
+    static TranspositionTableEntry unpack(uint64_t data)
+    {
+      TranspositionTableEntry entry;
+
+      entry.score = (int32_t)(data & 0xFFFFFFFF);
+      entry.bestMove = (data >> 32) & 0xFFFF;
+      entry.depth = (int8_t)((data >> 48) & 0xFF);
+      entry.bound = (data >> 56) & 0xFF;
+
+      return entry;
+    }
+  };
+}
\ No newline at end of file
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <iostream>
+#include <mutex>
+#include <string>
+
+namespace TungstenChess
+{
+  /**
+   * @brief Writes text to stdout in a single write under a shared lock. The search thread and the UCI input thread both write to
+   *        stdout, so all output goes through here to keep their lines from interleaving
+   * @param text The text to write, including the trailing newline
+   */
+  inline void printOutput(const std::string &text)
+  {
+    static std::mutex outputMutex;
+
+    std::lock_guard<std::mutex> lock(outputMutex);
+    std::cout << text << std::flush;
+  }
+}
\ No newline at end of file
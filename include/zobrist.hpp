@@ -5,6 +5,8 @@
 
 #include "types.hpp"
 
+#define ZOBRIST_SEED 0x54756E677374656EULL // Fixed so that keys are the same in every run, which the opening book relies on
+
 namespace TungstenChess
 {
   typedef uint64_t ZobristKey;
@@ -47,25 +49,25 @@ namespace TungstenChess
 
   private:
     /**
-     * @brief Populates the pieceKeys, castlingKeys, enPassantKeys, and sideKey vectors with random keys
+     * @brief Populates the pieceKeys, castlingKeys, enPassantKeys, and sideKey vectors with pseudo-random keys
      */
     Zobrist()
     {
-      std::random_device rd;
-      std::mt19937_64 gen(rd());
-      std::uniform_int_distribution<ZobristKey> dis(0, 0xFFFFFFFFFFFFFFFF);
+      // std::mt19937_64 output is fully specified by the standard (unlike distributions), so every platform gets the same keys
+      std::mt19937_64 gen(ZOBRIST_SEED);
 
+      // Empty squares have no key, so a position has the same key whether it was set up from a FEN or reached by moves
       for (int i = 0; i < 64; i++)
         for (int j : validPieces)
-          pieceKeys[i][j] = dis(gen);
+          pieceKeys[i][j] = j == EMPTY ? 0 : gen();
 
       for (int i = 0; i < 16; i++)
-        castlingKeys[i] = dis(gen);
+        castlingKeys[i] = gen();
 
       for (int i = 0; i < 9; i++)
-        enPassantKeys[i] = dis(gen);
+        enPassantKeys[i] = gen();
 
-      sideKey = dis(gen);
+      sideKey = gen();
 
       for (int i = 0; i < 64; i++)
         for (int j : validPieces)
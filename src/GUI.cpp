@@ -19,7 +19,7 @@ namespace TungstenChess
   {
     this->window = &window;
 
-    bot.loadOpeningBook(resourceManager.openingBookPath, resourceManager.openingBookSize);
+    bot.loadOpeningBook(resourceManager.openingBookPath);
 
     loadSquareTextures();
     loadBoardSquares();
@@ -69,13 +69,11 @@ namespace TungstenChess
               if (promotionPiece == EMPTY || !(promotionPiece & board.sideToMove()))
                 continue;
 
-              promotionMove.promotionPieceType = promotionPiece & TYPE;
-
               draggingPieceIndex = NO_SQUARE;
 
               awaitingPromotion = false;
 
-              makeMove(promotionMove);
+              makeMove(Move(promotionMove, promotionPiece & TYPE));
             }
             else
             {
@@ -105,9 +103,9 @@ namespace TungstenChess
 
             int index = GUIHandler::getSquareIndex(event.mouseButton.x, event.mouseButton.y);
 
-            Move move(draggingPieceIndex, index, board[draggingPieceIndex], board[index], board.castlingRights(), board.enPassantFile(), board.halfmoveClock());
+            Move move = board.generateMove(draggingPieceIndex, index);
 
-            if (!(move.flags & PROMOTION))
+            if (!(move.flags() & PROMOTION))
             {
               makeMove(move);
             }
@@ -229,7 +227,7 @@ namespace TungstenChess
   {
     for (int i = 0; i < 64; i++)
     {
-      if (draggingPieceIndex == i || (awaitingPromotion && promotionMove.from == i))
+      if (draggingPieceIndex == i || (awaitingPromotion && promotionMove.from() == i))
         continue;
 
       if (!isThinking)
@@ -299,7 +297,7 @@ namespace TungstenChess
 
   void GUIHandler::makeMove(Move move)
   {
-    if (move.from == move.to)
+    if (move.from() == move.to())
       return;
 
     board.makeMove(move);
@@ -325,8 +323,8 @@ namespace TungstenChess
       }
     }
 
-    Bitboards::addBit(yellowHighlightsBitboard, move.from);
-    Bitboards::addBit(yellowHighlightsBitboard, move.to);
+    Bitboards::addBit(yellowHighlightsBitboard, move.from());
+    Bitboards::addBit(yellowHighlightsBitboard, move.to());
   }
 
   void GUIHandler::makeBotMove()
@@ -44,7 +44,6 @@ namespace TungstenChess
     }
 
     std::string openingBookPath;
-    uint openingBookSize;
 
     Texture yellowOutlineTexture;
     Texture pieceTextures[PIECE_NUMBER];
@@ -66,7 +65,6 @@ namespace TungstenChess
       CFRelease(resourcesURL);
 
       openingBookPath = resourcePath + "opening_book";
-      openingBookSize = std::ifstream(openingBookPath, std::ios::binary | std::ios::ate).tellg() / sizeof(uint);
 
       yellowOutlineTexture.loadFromFile(resourcePath + "yellow_outline.png");
 
@@ -1,6 +1,14 @@
 #include <iostream>
+#include <sstream>
 #include <string>
 #include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+#include <cstdint>
+#include <charconv>
+#include <limits>
 
 #include "board.hpp"
 #include "bot.hpp"
@@ -24,76 +32,290 @@ std::vector<std::string> split(std::string str, std::string delimiter)
   return splitString;
 }
 
+/**
+ * @brief Joins tokens with spaces
+ * @param first The first token to join
+ * @param last One past the last token to join
+ */
+std::string join(std::vector<std::string>::const_iterator first, std::vector<std::string>::const_iterator last)
+{
+  std::string joined = "";
+
+  for (auto token = first; token != last; token++)
+    joined += (token == first ? "" : " ") + *token;
+
+  return joined;
+}
+
+/**
+ * @brief Parses a whole token as an integer without throwing, saturating numbers that do not fit
+ * @param text The token to parse
+ * @param value Set to the parsed value, if the token is a number
+ * @return Whether the token is a number
+ */
+bool parseInteger(const std::string &text, long long &value)
+{
+  auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+
+  if (end != text.data() + text.size() || (error != std::errc() && error != std::errc::result_out_of_range))
+    return false;
+
+  if (error == std::errc::result_out_of_range)
+    value = text[0] == '-' ? std::numeric_limits<long long>::min() : std::numeric_limits<long long>::max();
+
+  return true;
+}
+
+/**
+ * @brief Parses the value of a spin option, clamped to the range the option advertises
+ * @param text The value to parse
+ * @param min The minimum of the option
+ * @param max The maximum of the option
+ * @param value Set to the parsed value, if the text is a number
+ * @return Whether the text is a number
+ */
+bool parseSpinValue(const std::string &text, int min, int max, int &value)
+{
+  long long parsedValue;
+
+  if (!parseInteger(text, parsedValue))
+    return false;
+
+  value = std::clamp<long long>(parsedValue, min, max);
+  return true;
+}
+
+/**
+ * @brief Parses the arguments of a "go" command, ignoring unknown and malformed ones
+ * @param splitInput The command split by spaces, starting with "go"
+ */
+SearchLimits parseGoCommand(const std::vector<std::string> &splitInput)
+{
+  SearchLimits limits;
+
+  for (size_t i = 1; i < splitInput.size(); i++)
+  {
+    const std::string &argument = splitInput[i];
+
+    if (argument == "infinite")
+    {
+      limits.infinite = true;
+      continue;
+    }
+
+    if (argument == "ponder")
+    {
+      limits.ponder = true;
+      continue;
+    }
+
+    // A malformed value is skipped along with its argument, and is then read as an (unknown) argument itself
+    long long value;
+    if (i + 1 >= splitInput.size() || !parseInteger(splitInput[i + 1], value))
+      continue;
+
+    i++;
+
+    // Clock times can be negative when the engine is already over time, so they are clamped to 1 ms
+    int clampedValue = std::clamp<long long>(value, 0, INT32_MAX);
+
+    if (argument == "wtime")
+      limits.whiteTime = std::max(clampedValue, 1);
+    else if (argument == "btime")
+      limits.blackTime = std::max(clampedValue, 1);
+    else if (argument == "winc")
+      limits.whiteIncrement = clampedValue;
+    else if (argument == "binc")
+      limits.blackIncrement = clampedValue;
+    else if (argument == "movestogo")
+      limits.movesToGo = clampedValue;
+    else if (argument == "movetime")
+      limits.moveTime = std::max(clampedValue, 1);
+    else if (argument == "depth")
+      limits.depth = std::max(clampedValue, 1);
+    else if (argument == "nodes")
+      limits.nodes = std::max<long long>(value, 1);
+    else
+      i--;
+  }
+
+  return limits;
+}
+
 int main()
 {
   Board board(START_FEN);
 
-  Bot bot(board);
+  BotSettings botSettings;
+
+  Bot bot(board, botSettings);
+
+  const int maxThreads = std::max(std::thread::hardware_concurrency(), 1U);
 
-  std::cout << "TungstenChess v1.0\n";
+  // Searches run on the bot's search thread so that input is still read while thinking. Infinite and ponder searches
+  // must not report their best move before "stop" (or "ponderhit" for ponder searches), even if they finish early
+  std::mutex bestMoveMutex;
+  std::condition_variable bestMoveCondition;
+  bool holdBestMove = false;
+  bool infiniteSearch = false;
+
+  auto releaseBestMove = [&]()
+  {
+    {
+      std::lock_guard<std::mutex> lock(bestMoveMutex);
+      holdBestMove = false;
+    }
+    bestMoveCondition.notify_all();
+  };
+
+  // Aborts the running search (if any) and waits until its best move has been reported
+  auto stopSearch = [&]()
+  {
+    bot.stopSearch();
+    releaseBestMove();
+    bot.waitForSearch();
+  };
+
+  printOutput("TungstenChess v1.0\n");
 
   while (true)
   {
     std::string input;
-    std::getline(std::cin, input);
+    if (!std::getline(std::cin, input))
+      input = "quit";
 
     if (input == "quit")
     {
+      stopSearch();
       break;
     }
 
+    if (input == "stop")
+    {
+      stopSearch();
+      continue;
+    }
+
+    if (input == "ponderhit")
+    {
+      bot.ponderHit();
+
+      if (!infiniteSearch)
+        releaseBestMove();
+      continue;
+    }
+
     if (input == "uci")
     {
-      std::cout << "id name TungstenChess" << std::endl
-                << "id author Pradyun Gaddam" << std::endl
-                << "uciok" << std::endl;
+      std::ostringstream response;
+
+      response << "id name TungstenChess\n"
+               << "id author Pradyun Gaddam\n"
+               << "option name Threads type spin default 1 min 1 max " << maxThreads << "\n"
+               << "option name Ponder type check default false\n"
+               << "option name MultiPV type spin default 1 min 1 max " << MAX_MOVES << "\n"
+               << "option name BookFile type string default <empty>\n"
+               << "uciok\n";
+
+      printOutput(response.str());
       continue;
     }
 
     if (input == "isready")
     {
-      std::cout << "readyok" << std::endl;
+      printOutput("readyok\n");
       continue;
     }
 
+    std::string command = input.substr(0, input.find(' '));
+
+    // These commands read or change the board or the bot settings, which the search thread uses
+    if (command == "ucinewgame" || command == "d" || command == "setoption" || command == "go" || command == "position" || command == "moves")
+      stopSearch();
+
     if (input == "ucinewgame")
     {
       board.resetBoard();
+      bot.clearTranspositionTable();
       continue;
     }
 
     if (input == "d")
     {
-      std::cout << "\n";
+      std::ostringstream display;
+
+      display << "\n";
       for (int i = 0; i < 64; i++)
       {
         if (i % 8 == 0)
         {
-          std::cout << " +---+---+---+---+---+---+---+---+\n ";
+          display << " +---+---+---+---+---+---+---+---+\n ";
         }
 
-        std::cout << "| "
-                  << " ........PNBRQK..pnbrqk"[board[i]] << " ";
+        display << "| "
+                << " ........PNBRQK..pnbrqk"[board[i]] << " ";
 
         if (i % 8 == 7)
         {
-          std::cout << "| " << 8 - (i >> 3) << "\n";
+          display << "| " << 8 - (i >> 3) << "\n";
         }
       }
 
-      std::cout << " +---+---+---+---+---+---+---+---+\n";
-      std::cout << "   a   b   c   d   e   f   g   h\n\n";
+      display << " +---+---+---+---+---+---+---+---+\n";
+      display << "   a   b   c   d   e   f   g   h\n\n";
+
+      display << "Side to move: " << (board.sideToMove() == WHITE ? "White" : "Black") << "\n";
+      display << "Zobrist key: " << board.zobristKey() << "\n";
 
-      std::cout << "Side to move: " << (board.sideToMove() == WHITE ? "White" : "Black") << "\n";
-      std::cout << "Zobrist key: " << board.zobristKey() << "\n";
+      printOutput(display.str());
     }
 
     std::vector<std::string> splitInput = split(input, " ");
 
+    if (splitInput[0] == "setoption")
+    {
+      // Values (such as book file paths) can contain spaces, so the value is every token after "value"
+      auto valueToken = std::find(splitInput.cbegin(), splitInput.cend(), "value");
+
+      if (splitInput.size() > 2 && splitInput[1] == "name" && valueToken != splitInput.cend())
+      {
+        std::string name = join(splitInput.cbegin() + 2, valueToken);
+        std::string value = join(valueToken + 1, splitInput.cend());
+
+        if (name == "Threads")
+          parseSpinValue(value, 1, maxThreads, botSettings.threads);
+        else if (name == "MultiPV")
+          parseSpinValue(value, 1, MAX_MOVES, botSettings.multiPV);
+        else if (name == "BookFile" && !bot.loadOpeningBook(value) && value != "<empty>")
+          printOutput("info string Could not load opening book " + value + "\n");
+
+        bot.updateSettings(botSettings);
+      }
+      continue;
+    }
+
     if (splitInput[0] == "go")
     {
-      Move bestMove = bot.generateBotMove();
-      std::cout << "bestmove " << bestMove.getUCI() << "\n";
+      SearchLimits limits = parseGoCommand(splitInput);
+
+      // A bare "go" searches with the limits from the bot settings
+      if (!(limits.whiteTime || limits.blackTime || limits.moveTime || limits.depth || limits.nodes || limits.infinite))
+      {
+        bool ponder = limits.ponder;
+        limits = bot.getDefaultSearchLimits();
+        limits.ponder = ponder;
+      }
+
+      holdBestMove = limits.infinite || limits.ponder;
+      infiniteSearch = limits.infinite;
+
+      bot.startSearch(limits, [&](Move bestMove)
+                      {
+                        std::unique_lock<std::mutex> lock(bestMoveMutex);
+                        bestMoveCondition.wait(lock, [&]() { return !holdBestMove; });
+
+                        // "0000" is the UCI null move, sent when there are no legal moves
+                        printOutput("bestmove " + (bestMove.isNull() ? std::string("0000") : bestMove.getUCI()) + "\n"); });
       continue;
     }
 
@@ -1,3 +1,5 @@
+#include <charconv>
+
 #include "board.hpp" // See for documentation and helper function implementations
 
 namespace TungstenChess
@@ -9,6 +11,9 @@ namespace TungstenChess
       if (m_board[i])
       {
         m_zobristKey ^= zobrist.pieceKeys[i][m_board[i]];
+
+        if ((m_board[i] & TYPE) == PAWN)
+          m_pawnZobristKey ^= zobrist.pieceKeys[i][m_board[i]];
       }
     }
 
@@ -19,6 +24,18 @@ namespace TungstenChess
       m_zobristKey ^= zobrist.sideKey;
   }
 
+  void Board::calculateInitialEvaluation()
+  {
+    m_materialEvaluation = 0;
+    m_pieceSquareEvaluation = 0;
+
+    for (int i = 0; i < 64; i++)
+    {
+      m_materialEvaluation += getPieceMaterial(m_board[i]);
+      m_pieceSquareEvaluation += getPieceSquareValue(m_board[i], i);
+    }
+  }
+
   void Board::resetBoard(std::string fen)
   {
     std::string fenParts[NUM_FEN_PARTS];
@@ -29,7 +46,9 @@ namespace TungstenChess
     {
       if (fen[i] == ' ')
       {
-        fenPartIndex++;
+        if (++fenPartIndex == NUM_FEN_PARTS)
+          break;
+
         continue;
       }
 
@@ -38,6 +57,7 @@ namespace TungstenChess
 
     m_castlingRights = 0;
     m_enPassantFile = NO_EP;
+    m_hasCastled = 0;
 
     for (int i = 0; i < ALL_PIECES + 1; i++)
       m_bitboards[i] = 0;
@@ -89,34 +109,52 @@ namespace TungstenChess
       m_enPassantFile = fenParts[FEN_EN_PASSANT][0] - 'a';
     }
 
+    // Repetition detection scans back by the halfmove clock, so a missing or malformed field falls back to 0
+    const std::string &halfmoveClock = fenParts[FEN_HALFMOVE_CLOCK];
+    auto [end, error] = std::from_chars(halfmoveClock.data(), halfmoveClock.data() + halfmoveClock.size(), m_halfmoveClock);
+
+    if (error != std::errc() || end != halfmoveClock.data() + halfmoveClock.size() || m_halfmoveClock < 0)
+      m_halfmoveClock = 0;
+
     m_zobristKey = 0;
+    m_pawnZobristKey = 0;
 
     calculateInitialZobristKey();
+    calculateInitialEvaluation();
 
+    m_positionHistory.clear();
     m_positionHistory.push_back(m_zobristKey);
 
     m_moveHistory.clear();
+    m_undoStack.clear();
   }
 
   void Board::makeMove(Move move)
   {
+    int from = move.from();
+    int to = move.to();
+    int flags = move.flags();
+
+    Piece piece = m_board[from];
+    Piece capturedPiece = m_board[to];
+
+    m_undoStack.push_back({capturedPiece, (uint8_t)m_castlingRights, (uint8_t)m_enPassantFile, m_halfmoveClock});
+
     switchSideToMove();
 
     m_halfmoveClock++;
 
-    if (m_board[move.to] || move.piece == PAWN)
+    if (capturedPiece || (piece & TYPE) == PAWN)
       m_halfmoveClock = 0;
 
     m_moveHistory.push_back(move.toInt());
 
-    auto [from, to, piece, capturedPiece, promotionPieceType, castlingRights, enPassantFile, halfmoveClock, flags] = move;
-
     PieceType pieceType = piece & TYPE;
     PieceColor pieceColor = piece & COLOR;
     PieceType capturedPieceType = capturedPiece & TYPE;
     PieceColor capturedPieceColor = capturedPiece & COLOR;
 
-    movePiece(from, to, (flags & PROMOTION) ? (promotionPieceType | pieceColor) : EMPTY);
+    movePiece(from, to, (flags & PROMOTION) ? (move.promotionPieceType() | pieceColor) : EMPTY);
 
     updateEnPassantFile(flags & PAWN_DOUBLE ? to % 8 : NO_EP);
 
@@ -146,30 +184,146 @@ namespace TungstenChess
 
   void Board::unmakeMove(Move move)
   {
+    UndoState undoState = m_undoStack.back();
+
+    m_undoStack.pop_back();
     m_positionHistory.pop_back();
     m_moveHistory.pop_back();
 
     switchSideToMove();
 
-    m_halfmoveClock = move.halfmoveClock;
+    m_halfmoveClock = undoState.halfmoveClock;
+
+    int from = move.from();
+    int to = move.to();
+    int flags = move.flags();
 
-    unmovePiece(move.from, move.to, move.piece, move.capturedPiece);
+    Piece piece = (flags & PROMOTION) ? ((m_board[to] & COLOR) | PAWN) : m_board[to];
 
-    if (move.flags & CASTLE)
+    unmovePiece(from, to, piece, undoState.capturedPiece);
+
+    if (flags & CASTLE)
     {
-      m_hasCastled &= ~(move.piece & COLOR);
+      m_hasCastled &= ~(piece & COLOR);
 
-      if (move.flags & KSIDE_CASTLE)
-        unmovePiece(move.to + 1, move.to - 1);
+      if (flags & KSIDE_CASTLE)
+        unmovePiece(to + 1, to - 1);
       else
-        unmovePiece(move.to - 2, move.to + 1);
+        unmovePiece(to - 2, to + 1);
     }
 
-    updateEnPassantFile(move.enPassantFile);
-    updateCastlingRights(move.castlingRights);
+    updateEnPassantFile(undoState.enPassantFile);
+    updateCastlingRights(undoState.castlingRights);
 
-    if (move.flags & EP_CAPTURE)
-      updatePiece((move.piece & WHITE) ? move.to + 8 : move.to - 8, move.piece ^ COLOR);
+    if (flags & EP_CAPTURE)
+      updatePiece((piece & WHITE) ? to + 8 : to - 8, piece ^ COLOR);
+  }
+
+  int Board::see(Move move)
+  {
+    // Kings are given a value larger than any possible gain, so a king recapture onto a defended square is never good
+    auto seeValue = [](PieceType pieceType)
+    { return pieceType == KING ? 10000 : PIECE_VALUES[pieceType]; };
+
+    int from = move.from();
+    int to = move.to();
+    int flags = move.flags();
+
+    std::array<int, 32> gain;
+    int depth = 0;
+
+    Bitboard occupied = m_bitboards[ALL_PIECES];
+    Bitboard bishopAttackers = m_bitboards[WHITE_BISHOP] | m_bitboards[BLACK_BISHOP] | m_bitboards[WHITE_QUEEN] | m_bitboards[BLACK_QUEEN];
+    Bitboard rookAttackers = m_bitboards[WHITE_ROOK] | m_bitboards[BLACK_ROOK] | m_bitboards[WHITE_QUEEN] | m_bitboards[BLACK_QUEEN];
+
+    PieceType attackerType = m_board[from] & TYPE;
+    PieceColor color = m_board[from] & COLOR;
+
+    gain[0] = (flags & EP_CAPTURE) ? PIECE_VALUES[PAWN] : PIECE_VALUES[m_board[to] & TYPE];
+
+    if (flags & PROMOTION)
+    {
+      gain[0] += PIECE_VALUES[move.promotionPieceType()] - PIECE_VALUES[PAWN];
+      attackerType = move.promotionPieceType();
+    }
+
+    if (flags & EP_CAPTURE)
+      occupied ^= 1ULL << (to + (color == WHITE ? 8 : -8));
+
+    Bitboard attackers = getAttackersBitboard(to, occupied);
+    Bitboard fromBitboard = 1ULL << from;
+
+    while (true)
+    {
+      depth++;
+
+      // The value of the exchange if the piece on the target square is captured next
+      gain[depth] = seeValue(attackerType) - gain[depth - 1];
+
+      if (std::max(-gain[depth - 1], gain[depth]) < 0 || depth == (int)gain.size() - 1)
+        break;
+
+      occupied ^= fromBitboard;
+      attackers &= occupied;
+
+      // Removing the capturing piece may reveal a slider behind it
+      if (attackerType == PAWN || attackerType == BISHOP || attackerType == QUEEN)
+        attackers |= magicMoveGen.getBishopMoves(to, occupied) & bishopAttackers & occupied;
+      if (attackerType == ROOK || attackerType == QUEEN)
+        attackers |= magicMoveGen.getRookMoves(to, occupied) & rookAttackers & occupied;
+
+      color ^= COLOR;
+
+      fromBitboard = 0;
+
+      for (PieceType pieceType = PAWN; pieceType <= KING; pieceType++)
+      {
+        if (Bitboard pieceAttackers = attackers & m_bitboards[color | pieceType])
+        {
+          fromBitboard = pieceAttackers & -pieceAttackers;
+          attackerType = pieceType;
+          break;
+        }
+      }
+
+      if (!fromBitboard)
+        break;
+    }
+
+    while (--depth)
+      gain[depth - 1] = -std::max(-gain[depth - 1], gain[depth]);
+
+    return gain[0];
+  }
+
+  void Board::makeNullMove()
+  {
+    m_undoStack.push_back({EMPTY, (uint8_t)m_castlingRights, (uint8_t)m_enPassantFile, m_halfmoveClock});
+
+    switchSideToMove();
+
+    m_halfmoveClock = 0;
+
+    m_moveHistory.push_back(NULL_MOVE);
+
+    updateEnPassantFile(NO_EP);
+
+    m_positionHistory.push_back(m_zobristKey);
+  }
+
+  void Board::unmakeNullMove()
+  {
+    UndoState undoState = m_undoStack.back();
+
+    m_undoStack.pop_back();
+    m_positionHistory.pop_back();
+    m_moveHistory.pop_back();
+
+    switchSideToMove();
+
+    m_halfmoveClock = undoState.halfmoveClock;
+
+    updateEnPassantFile(undoState.enPassantFile);
   }
 
   Bitboard Board::getPawnMoves(int pieceIndex, PieceColor color, bool _)
@@ -252,166 +406,237 @@ namespace TungstenChess
     return movesBitboard;
   }
 
-  Bitboard Board::getLegalPieceMovesBitboard(int pieceIndex, PieceColor color, bool onlyCaptures)
+  Bitboard Board::getLegalPieceMovesBitboard(int pieceIndex, PieceColor color, int generationType)
   {
-    Bitboard pseudoLegalMovesBitboard = getPseudoLegalPieceMoves(pieceIndex, color, !onlyCaptures);
+    return getLegalPieceMovesBitboard(pieceIndex, color, getMoveGenerationMasks(color), generationType);
+  }
+
+  Bitboard Board::getLegalPieceMovesBitboard(int pieceIndex, PieceColor color, const MoveGenerationMasks &masks, int generationType)
+  {
+    Bitboard generationMask = getGenerationMask(color, generationType);
+    PieceType pieceType = m_board[pieceIndex] & TYPE;
+
+    if (pieceType == KING)
+    {
+      Bitboard kingDanger = getAttackedSquares(color ^ COLOR, m_bitboards[ALL_PIECES] & ~(1ULL << pieceIndex));
+
+      Bitboard movesBitboard = movesLookup.KING_MOVES[pieceIndex] & ~m_bitboards[color] & ~kingDanger;
+
+      if (generationType != CAPTURE_MOVES && !masks.checkers && m_castlingRights)
+      {
+        int kingsideRights = color == WHITE ? WHITE_KINGSIDE : BLACK_KINGSIDE;
+        int queensideRights = color == WHITE ? WHITE_QUEENSIDE : BLACK_QUEENSIDE;
+
+        // Castling is only generated from the king's starting square, where the paths below are always on the king's rank
+        if ((m_castlingRights & kingsideRights) && !(m_bitboards[ALL_PIECES] & (3ULL << (pieceIndex + 1))) && !(kingDanger & (3ULL << (pieceIndex + 1))))
+          Bitboards::addBit(movesBitboard, pieceIndex + 2);
+
+        if ((m_castlingRights & queensideRights) && !(m_bitboards[ALL_PIECES] & (7ULL << (pieceIndex - 3))) && !(kingDanger & (3ULL << (pieceIndex - 2))))
+          Bitboards::addBit(movesBitboard, pieceIndex - 2);
+      }
+
+      return movesBitboard & generationMask;
+    }
+
+    if (Bitboards::countBits(masks.checkers) > 1)
+      return 0;
+
+    Bitboard movesBitboard = getPseudoLegalPieceMoves(pieceIndex, color, false) & generationMask;
+
+    Bitboard legalMask = masks.checkMask;
 
-    if (onlyCaptures)
-      pseudoLegalMovesBitboard &= m_bitboards[color ^ COLOR];
+    if (Bitboards::hasBit(masks.pinned, pieceIndex))
+      legalMask &= movesLookup.LINE_SQUARES[m_kingIndices[color | KING]][pieceIndex];
 
     Bitboard legalMovesBitboard = 0;
 
-    while (pseudoLegalMovesBitboard)
+    // En passant can uncover a check along the rank of both pawns, or capture a checking pawn that is not on the target square,
+    // so it is the only move that is still checked by making it
+    if (pieceType == PAWN && m_enPassantFile != NO_EP)
     {
-      int toIndex = Bitboards::popBit(pseudoLegalMovesBitboard);
+      int enPassantSquare = m_enPassantFile + (color == WHITE ? 16 : 40);
 
-      MoveFlags flag = quickMakeMove(pieceIndex, toIndex);
+      if (Bitboards::hasBit(movesBitboard, enPassantSquare))
+      {
+        Bitboards::removeBit(movesBitboard, enPassantSquare);
 
-      if (!isInCheck(color))
-        Bitboards::addBit(legalMovesBitboard, toIndex);
+        MoveFlags flag = quickMakeMove(pieceIndex, enPassantSquare);
+
+        if (!isInCheck(color))
+          Bitboards::addBit(legalMovesBitboard, enPassantSquare);
 
-      quickUnmakeMove(pieceIndex, toIndex, flag);
+        quickUnmakeMove(pieceIndex, enPassantSquare, flag);
+      }
     }
 
-    return legalMovesBitboard;
+    return legalMovesBitboard | (movesBitboard & legalMask);
   }
 
-  Bitboard Board::getAttackingPiecesBitboard(int targetSquare, Piece targetPiece, PieceColor color)
+  MoveGenerationMasks Board::getMoveGenerationMasks(PieceColor color)
   {
-    Bitboard attackingPiecesBitboard = 0;
+    MoveGenerationMasks masks;
 
-    if (targetPiece)
-    {
-      if (Bitboard attackingPawns = movesLookup.PAWN_CAPTURE_MOVES[color ^ COLOR][targetSquare] & m_bitboards[color | PAWN])
-        attackingPiecesBitboard |= attackingPawns;
-    }
+    PieceColor opposingColor = color ^ COLOR;
+
+    int kingIndex = m_kingIndices[color | KING];
+
+    masks.checkers = getAttackersBitboard(kingIndex, m_bitboards[ALL_PIECES]) & m_bitboards[opposingColor];
+
+    if (!masks.checkers)
+      masks.checkMask = ~0ULL;
+    else if (Bitboards::countBits(masks.checkers) == 1)
+      masks.checkMask = masks.checkers | movesLookup.BETWEEN_SQUARES[kingIndex][__builtin_ctzll(masks.checkers)];
     else
+      masks.checkMask = 0;
+
+    masks.pinned = 0;
+
+    // Enemy sliders that would attack the king if friendly pieces were transparent
+    Bitboard snipers = (magicMoveGen.getBishopMoves(kingIndex, m_bitboards[opposingColor]) & (m_bitboards[opposingColor | BISHOP] | m_bitboards[opposingColor | QUEEN])) |
+                       (magicMoveGen.getRookMoves(kingIndex, m_bitboards[opposingColor]) & (m_bitboards[opposingColor | ROOK] | m_bitboards[opposingColor | QUEEN]));
+
+    while (snipers)
     {
-      Bitboard reverseSinglePawnMoveSquare = movesLookup.PAWN_REVERSE_SINGLE_MOVES[color][targetSquare];
+      int sniperIndex = Bitboards::popBit(snipers);
 
-      if (Bitboard attackingSingleMovePawns = reverseSinglePawnMoveSquare & m_bitboards[color | PAWN])
-      {
-        attackingPiecesBitboard |= attackingSingleMovePawns;
-      }
-      else if (!(reverseSinglePawnMoveSquare & m_bitboards[ALL_PIECES]))
-      {
-        Bitboard reverseDoublePawnMoveSquare = movesLookup.PAWN_REVERSE_DOUBLE_MOVES[color][targetSquare];
+      Bitboard blockers = movesLookup.BETWEEN_SQUARES[kingIndex][sniperIndex] & m_bitboards[ALL_PIECES];
 
-        if (Bitboard attackingDoubleMovePawns = reverseDoublePawnMoveSquare & m_bitboards[color | PAWN])
-          attackingPiecesBitboard |= attackingDoubleMovePawns;
-      }
+      if (Bitboards::countBits(blockers) == 1)
+        masks.pinned |= blockers & m_bitboards[color];
     }
 
-    if (Bitboard attackingKnights = movesLookup.KNIGHT_MOVES[targetSquare] & m_bitboards[color | KNIGHT])
-      attackingPiecesBitboard |= attackingKnights;
+    return masks;
+  }
+
+  Bitboard Board::getAttackedSquares(PieceColor color, Bitboard occupied)
+  {
+    Bitboard attackedSquares = movesLookup.KING_MOVES[m_kingIndices[color | KING]];
+
+    for (Bitboard pawns = m_bitboards[color | PAWN]; pawns;)
+      attackedSquares |= movesLookup.PAWN_CAPTURE_MOVES[color][Bitboards::popBit(pawns)];
+
+    for (Bitboard knights = m_bitboards[color | KNIGHT]; knights;)
+      attackedSquares |= movesLookup.KNIGHT_MOVES[Bitboards::popBit(knights)];
 
-    if (Bitboard attackingDiagonalSliders = getBishopMoves(targetSquare, color ^ COLOR) & (m_bitboards[color | BISHOP] | m_bitboards[color | QUEEN]))
-      attackingPiecesBitboard |= attackingDiagonalSliders;
+    for (Bitboard diagonalSliders = m_bitboards[color | BISHOP] | m_bitboards[color | QUEEN]; diagonalSliders;)
+      attackedSquares |= magicMoveGen.getBishopMoves(Bitboards::popBit(diagonalSliders), occupied);
 
-    if (Bitboard attackingOrthogonalSliders = getRookMoves(targetSquare, color ^ COLOR) & (m_bitboards[color | ROOK] | m_bitboards[color | QUEEN]))
-      attackingPiecesBitboard |= attackingOrthogonalSliders;
+    for (Bitboard orthogonalSliders = m_bitboards[color | ROOK] | m_bitboards[color | QUEEN]; orthogonalSliders;)
+      attackedSquares |= magicMoveGen.getRookMoves(Bitboards::popBit(orthogonalSliders), occupied);
 
-    return attackingPiecesBitboard;
+    return attackedSquares;
   }
 
-  std::vector<Move> Board::getLegalMoves(PieceColor color, bool onlyCaptures)
+  MoveList Board::getLegalMoves(PieceColor color, int generationType)
   {
-    std::vector<Move> legalMoves;
-    legalMoves.reserve(256);
+    MoveList legalMoves;
 
-    Bitboard movablePiecesBitboard = 0;
-    Bitboard targetSquaresBitboard = 0;
+    MoveGenerationMasks masks = getMoveGenerationMasks(color);
 
-    if (Bitboard attackingKnights = movesLookup.KNIGHT_MOVES[m_kingIndices[color | KING]] & m_bitboards[(color ^ COLOR) | KNIGHT])
-    {
-      movablePiecesBitboard = m_bitboards[color | KING];
+    Bitboard movablePiecesBitboard = m_bitboards[color | KING];
 
-      if (Bitboards::countBits(attackingKnights) == 1)
-        targetSquaresBitboard = attackingKnights;
-    }
-    else
+    if (Bitboards::countBits(masks.checkers) <= 1)
     {
-      Bitboard diagonalMoves = magicMoveGen.getBishopMoves(m_kingIndices[color | KING], m_bitboards[ALL_PIECES]);
-      Bitboard orthogonalMoves = magicMoveGen.getRookMoves(m_kingIndices[color | KING], m_bitboards[ALL_PIECES]);
+      // Pinned pawns are rare, so they go through the per-piece generator instead of restricting every set-wise pawn move
+      Bitboard unpinnedPawns = m_bitboards[color | PAWN] & ~masks.pinned;
 
-      PieceColor opposingColor = color ^ COLOR;
+      addPawnMoves(legalMoves, color, unpinnedPawns, masks.checkMask, getGenerationMask(color, generationType));
 
-      Bitboard attackingDiagonalSliders = diagonalMoves & (m_bitboards[opposingColor | BISHOP] | m_bitboards[opposingColor | QUEEN]);
-      Bitboard attackingOrthogonalSliders = orthogonalMoves & (m_bitboards[opposingColor | ROOK] | m_bitboards[opposingColor | QUEEN]);
-
-      if (!(attackingDiagonalSliders | attackingOrthogonalSliders))
-        movablePiecesBitboard = m_bitboards[color];
-      else
-      {
-        movablePiecesBitboard = m_bitboards[color | KING];
-        if (attackingDiagonalSliders)
-          targetSquaresBitboard = (diagonalMoves & movesLookup.BISHOP_MASKS[__builtin_ctzll(attackingDiagonalSliders)]) | attackingDiagonalSliders;
-        else if (attackingOrthogonalSliders)
-          targetSquaresBitboard = (orthogonalMoves & movesLookup.ROOK_MASKS[__builtin_ctzll(attackingOrthogonalSliders)]) | attackingOrthogonalSliders;
-      }
+      movablePiecesBitboard = m_bitboards[color] & ~unpinnedPawns;
     }
 
-    if (onlyCaptures)
-      targetSquaresBitboard &= m_bitboards[color ^ COLOR];
-
     while (movablePiecesBitboard)
     {
       int pieceIndex = Bitboards::popBit(movablePiecesBitboard);
 
-      Bitboard movesBitboard = getLegalPieceMovesBitboard(pieceIndex, color, onlyCaptures);
+      Bitboard movesBitboard = getLegalPieceMovesBitboard(pieceIndex, color, masks, generationType);
 
       while (movesBitboard)
-      {
-        int toIndex = Bitboards::popBit(movesBitboard);
+        addMove(legalMoves, pieceIndex, Bitboards::popBit(movesBitboard));
+    }
 
-        legalMoves.push_back(Move(pieceIndex, toIndex, m_board[pieceIndex], m_board[toIndex], m_castlingRights, m_enPassantFile, m_halfmoveClock, EMPTY));
+    return legalMoves;
+  }
 
-        Move &move = legalMoves.back();
+  void Board::addPawnMoves(MoveList &legalMoves, PieceColor color, Bitboard pawns, Bitboard checkMask, Bitboard generationMask)
+  {
+    constexpr Bitboard NOT_A_FILE = ~0x0101010101010101ULL;
+    constexpr Bitboard NOT_H_FILE = ~0x8080808080808080ULL;
 
-        if (move.flags & PROMOTION)
-        {
-          move.promotionPieceType = QUEEN;
-          legalMoves.push_back(Move(move, KNIGHT));
-          legalMoves.push_back(Move(move, BISHOP));
-          legalMoves.push_back(Move(move, ROOK));
-        }
-      }
-    }
+    Bitboard emptySquares = ~m_bitboards[ALL_PIECES];
+    Bitboard enemyPieces = m_bitboards[color ^ COLOR];
+
+    Bitboard singlePushes, doublePushes, leftCaptures, rightCaptures;
+
+    // Each set of targets is shifted back by a fixed offset to find the pawn that moves there
+    int singlePushOffset, leftCaptureOffset, rightCaptureOffset;
 
-    while (targetSquaresBitboard)
+    if (color == WHITE)
+    {
+      singlePushes = (pawns >> 8) & emptySquares;
+      doublePushes = ((singlePushes & Bitboards::rank(~0ULL, 5)) >> 8) & emptySquares;
+      leftCaptures = ((pawns & NOT_A_FILE) >> 9) & enemyPieces;
+      rightCaptures = ((pawns & NOT_H_FILE) >> 7) & enemyPieces;
+
+      singlePushOffset = 8;
+      leftCaptureOffset = 9;
+      rightCaptureOffset = 7;
+    }
+    else
     {
-      int targetSquare = Bitboards::popBit(targetSquaresBitboard);
+      singlePushes = (pawns << 8) & emptySquares;
+      doublePushes = ((singlePushes & Bitboards::rank(~0ULL, 2)) << 8) & emptySquares;
+      leftCaptures = ((pawns & NOT_A_FILE) << 7) & enemyPieces;
+      rightCaptures = ((pawns & NOT_H_FILE) << 9) & enemyPieces;
+
+      singlePushOffset = -8;
+      leftCaptureOffset = -7;
+      rightCaptureOffset = -9;
+    }
 
-      Piece targetPiece = m_board[targetSquare];
+    Bitboard targetMask = checkMask & generationMask;
 
-      Bitboard attackersBitboard = getAttackingPiecesBitboard(targetSquare, targetPiece, color);
+    for (Bitboard targets = singlePushes & targetMask; targets;)
+    {
+      int to = Bitboards::popBit(targets);
+      addMove(legalMoves, to + singlePushOffset, to);
+    }
+    for (Bitboard targets = doublePushes & targetMask; targets;)
+    {
+      int to = Bitboards::popBit(targets);
+      addMove(legalMoves, to + 2 * singlePushOffset, to);
+    }
+    for (Bitboard targets = leftCaptures & targetMask; targets;)
+    {
+      int to = Bitboards::popBit(targets);
+      addMove(legalMoves, to + leftCaptureOffset, to);
+    }
+    for (Bitboard targets = rightCaptures & targetMask; targets;)
+    {
+      int to = Bitboards::popBit(targets);
+      addMove(legalMoves, to + rightCaptureOffset, to);
+    }
 
-      while (attackersBitboard)
-      {
-        int attackerIndex = Bitboards::popBit(attackersBitboard);
+    if (m_enPassantFile == NO_EP)
+      return;
 
-        MoveFlags flag = quickMakeMove(attackerIndex, targetSquare);
+    int enPassantSquare = m_enPassantFile + (color == WHITE ? 16 : 40);
 
-        if (!isInCheck(color))
-        {
-          legalMoves.push_back(Move(attackerIndex, targetSquare, m_board[attackerIndex], m_board[targetSquare], m_castlingRights, m_enPassantFile, m_halfmoveClock, EMPTY));
+    if (!Bitboards::hasBit(generationMask, enPassantSquare))
+      return;
 
-          Move &move = legalMoves.back();
+    // En passant is checked by making the move, see getLegalPieceMovesBitboard
+    for (Bitboard attackers = movesLookup.PAWN_CAPTURE_MOVES[(color ^ COLOR) | PAWN][enPassantSquare] & pawns; attackers;)
+    {
+      int from = Bitboards::popBit(attackers);
 
-          if (flag & PROMOTION)
-          {
-            move.promotionPieceType = QUEEN;
-            legalMoves.push_back(Move(move, KNIGHT));
-            legalMoves.push_back(Move(move, BISHOP));
-            legalMoves.push_back(Move(move, ROOK));
-          }
-        }
+      MoveFlags flag = quickMakeMove(from, enPassantSquare);
 
-        quickUnmakeMove(attackerIndex, targetSquare, flag);
-      }
-    }
+      if (!isInCheck(color))
+        legalMoves.push_back(generateMove(from, enPassantSquare));
 
-    return legalMoves;
+      quickUnmakeMove(from, enPassantSquare, flag);
+    }
   }
 
   bool Board::isAttacked(int square, PieceColor color)
@@ -438,16 +663,18 @@ namespace TungstenChess
 
   int Board::getGameStatus(PieceColor color)
   {
-    if (countRepetitions(m_zobristKey) >= 3)
+    if (countRepetitions() >= 2)
       return STALEMATE;
 
+    MoveGenerationMasks masks = getMoveGenerationMasks(color);
+
     Bitboard friendlyPiecesBitboard = m_bitboards[color];
 
     while (friendlyPiecesBitboard)
     {
       int pieceIndex = Bitboards::popBit(friendlyPiecesBitboard);
 
-      if (getLegalPieceMovesBitboard(pieceIndex))
+      if (getLegalPieceMovesBitboard(pieceIndex, color, masks, ALL_MOVES))
         return m_halfmoveClock >= 100 ? STALEMATE : NO_MATE;
     }
 
@@ -459,9 +686,6 @@ namespace TungstenChess
     int from = (uci[0] - 'a') + (8 - uci[1] + '0') * 8;
     int to = (uci[2] - 'a') + (8 - uci[3] + '0') * 8;
 
-    Piece piece = m_board[from];
-    Piece capturedPiece = m_board[to];
-
     PieceType promotionPieceType = EMPTY;
 
     if (uci.length() == 5)
@@ -483,70 +707,74 @@ namespace TungstenChess
       }
     }
 
-    return Move(from, to, piece, capturedPiece, m_castlingRights, m_enPassantFile, m_halfmoveClock, promotionPieceType);
+    return generateMove(from, to, promotionPieceType);
   }
 
   std::string Board::getMovePGN(Move move)
   {
     std::string pgn = "";
 
-    if (move.flags & CASTLE)
+    int from = move.from();
+    int to = move.to();
+    int flags = move.flags();
+
+    if (flags & CASTLE)
     {
-      if (move.flags & KSIDE_CASTLE)
+      if (flags & KSIDE_CASTLE)
         pgn += "O-O";
       else
         pgn += "O-O-O";
     }
     else
     {
-      PieceType pieceType = move.piece & TYPE;
+      PieceType pieceType = m_board[from] & TYPE;
 
       if (pieceType != PAWN)
       {
         pgn += "..NBRQK"[pieceType];
 
-        Bitboard sameTypePieces = m_bitboards[move.piece] & ~(1ULL << move.from);
+        Bitboard sameTypePieces = m_bitboards[m_board[from]] & ~(1ULL << from);
         Bitboard ambiguousPieces = 0;
 
         while (sameTypePieces)
         {
           int pieceIndex = Bitboards::popBit(sameTypePieces);
 
-          if (Bitboards::hasBit(getLegalPieceMovesBitboard(pieceIndex), move.to))
+          if (Bitboards::hasBit(getLegalPieceMovesBitboard(pieceIndex), to))
             Bitboards::addBit(ambiguousPieces, pieceIndex);
         }
 
         if (ambiguousPieces)
         {
-          if (Bitboards::file(ambiguousPieces, move.from % 8))
+          if (Bitboards::file(ambiguousPieces, from % 8))
           {
-            if (Bitboards::rank(ambiguousPieces, move.from / 8))
-              pgn += 'a' + (move.from % 8);
-            pgn += '8' - (move.from / 8);
+            if (Bitboards::rank(ambiguousPieces, from / 8))
+              pgn += 'a' + (from % 8);
+            pgn += '8' - (from / 8);
           }
           else
-            pgn += 'a' + (move.from % 8);
+            pgn += 'a' + (from % 8);
         }
       }
 
-      if (move.flags & (CAPTURE | EP_CAPTURE))
+      if (flags & (CAPTURE | EP_CAPTURE))
       {
         if (pieceType == PAWN)
         {
-          pgn += 'a' + (move.from % 8);
+          pgn += 'a' + (from % 8);
         }
         pgn += 'x';
       }
 
-      pgn += 'a' + (move.to % 8);
-      pgn += '8' - (move.to / 8);
+      pgn += 'a' + (to % 8);
+      pgn += '8' - (to / 8);
 
-      if (move.flags & EP_CAPTURE)
+      if (flags & EP_CAPTURE)
         pgn += " e.p.";
-      else if (move.flags & PROMOTION)
+      else if (flags & PROMOTION)
       {
         pgn += "=";
-        pgn += "..NBRQ"[move.promotionPieceType];
+        pgn += "..NBRQ"[move.promotionPieceType()];
       }
     }
 
@@ -562,39 +790,23 @@ namespace TungstenChess
     return pgn;
   }
 
-  int Board::countGames(int depth, bool verbose)
+  uint64_t Board::countGames(int depth)
   {
     if (depth == 0)
       return 1;
 
-    std::vector<Move> legalMoves = getLegalMoves(m_sideToMove);
+    MoveList legalMoves = getLegalMoves(m_sideToMove);
 
-    int legalMovesCount = legalMoves.size();
+    if (depth == 1)
+      return legalMoves.size();
 
-    int games = 0;
+    uint64_t games = 0;
 
-    for (int i = 0; i < legalMovesCount; i++)
+    for (Move move : legalMoves)
     {
-      if (depth == 1)
-      {
-        games++;
-
-        if (verbose)
-          std::cout << legalMoves[i].getUCI() << ": 1" << std::endl;
-
-        continue;
-      }
-
-      makeMove(legalMoves[i]);
-
-      int newGames = countGames(depth - 1, false);
-
-      if (verbose)
-        std::cout << legalMoves[i].getUCI() << ": " << newGames << std::endl;
-
-      games += newGames;
-
-      unmakeMove(legalMoves[i]);
+      makeMove(move);
+      games += countGames(depth - 1);
+      unmakeMove(move);
     }
 
     return games;
@@ -0,0 +1,183 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+
+#include "board.hpp"
+#include "opening_book.hpp"
+
+using namespace TungstenChess;
+
+/**
+ * @brief Converts a move tree book to the Zobrist indexed format (see OpeningBookHeader). The move tree format is a list of
+ *        4 byte entries in depth first order, each holding a move in bits 0-11, its weight in bits 12-24 and its depth (the
+ *        number of moves played before it from the start position) in bits 25-31
+ * @param inputPath The path to the move tree book
+ * @param entries The entries of every position in the book, unsorted and possibly with duplicates from transpositions
+ * @return Whether the book was read successfully
+ */
+bool readMoveTreeBook(const std::string &inputPath, std::vector<OpeningBookEntry> &entries)
+{
+  std::ifstream file(inputPath, std::ios::binary);
+  if (!file)
+  {
+    std::cerr << "Could not open " << inputPath << std::endl;
+    return false;
+  }
+
+  Board board;
+  std::vector<Move> line;
+
+  uint32_t treeEntry;
+  for (size_t i = 0; file.read((char *)&treeEntry, sizeof(treeEntry)); i++)
+  {
+    MoveInt moveInt = treeEntry & 0xFFF;
+    uint16_t weight = treeEntry >> 12 & 0x1FFF;
+    size_t depth = treeEntry >> 25;
+
+    if (depth > line.size())
+    {
+      std::cerr << "Entry " << i << " has no parent move" << std::endl;
+      return false;
+    }
+
+    while (line.size() > depth)
+    {
+      board.unmakeMove(line.back());
+      line.pop_back();
+    }
+
+    MoveList legalMoves = board.getLegalMoves(board.sideToMove());
+    auto move = std::find_if(legalMoves.begin(), legalMoves.end(), [moveInt](Move legalMove)
+                             { return legalMove.toInt() == moveInt; });
+
+    if (move == legalMoves.end())
+    {
+      std::cerr << "Entry " << i << " is not a legal move" << std::endl;
+      return false;
+    }
+
+    entries.push_back({board.zobristKey(), moveInt, weight, 0});
+
+    board.makeMove(*move);
+    line.push_back(*move);
+  }
+
+  return true;
+}
+
+/**
+ * @brief Sorts the entries by key and merges the duplicates of a move reached through different move orders
+ * @param entries The entries to sort and merge
+ */
+void sortAndMergeEntries(std::vector<OpeningBookEntry> &entries)
+{
+  std::sort(entries.begin(), entries.end(), [](const OpeningBookEntry &a, const OpeningBookEntry &b)
+            { return a.key != b.key ? a.key < b.key : a.move < b.move; });
+
+  std::vector<OpeningBookEntry> merged;
+
+  for (const OpeningBookEntry &entry : entries)
+  {
+    if (!merged.empty() && merged.back().key == entry.key && merged.back().move == entry.move)
+      merged.back().weight = std::min(merged.back().weight + entry.weight, (int)UINT16_MAX);
+    else
+      merged.push_back(entry);
+  }
+
+  entries = merged;
+}
+
+/**
+ * @brief Writes a Zobrist indexed book
+ * @param outputPath The path to write the book to
+ * @param entries The entries of the book, sorted by key
+ * @return Whether the book was written successfully
+ */
+bool writeBook(const std::string &outputPath, const std::vector<OpeningBookEntry> &entries)
+{
+  std::ofstream file(outputPath, std::ios::binary);
+
+  OpeningBookHeader header = {OPENING_BOOK_MAGIC, entries.size()};
+  file.write((const char *)&header, sizeof(header));
+  file.write((const char *)entries.data(), entries.size() * sizeof(OpeningBookEntry));
+
+  if (!file)
+  {
+    std::cerr << "Could not write " << outputPath << std::endl;
+    return false;
+  }
+
+  return true;
+}
+
+/**
+ * @brief Prints the book moves of a position
+ * @param bookPath The path to the Zobrist indexed book
+ * @param fen The position to look up
+ * @return Whether the book was loaded
+ */
+bool probeBook(const std::string &bookPath, const std::string &fen)
+{
+  OpeningBook openingBook;
+  if (!openingBook.loadOpeningBook(bookPath))
+  {
+    std::cerr << "Could not load " << bookPath << std::endl;
+    return false;
+  }
+
+  Board board(fen);
+  auto [first, last] = openingBook.getEntries(board.zobristKey());
+
+  if (first == last)
+    std::cout << "Position not in book" << std::endl;
+
+  for (Move move : board.getLegalMoves(board.sideToMove()))
+    for (const OpeningBookEntry *entry = first; entry != last; entry++)
+      if (entry->move == move.toInt())
+        std::cout << move.getUCI() << ": " << entry->weight << std::endl;
+
+  return true;
+}
+
+void printUsage()
+{
+  std::cout << "Usage:" << std::endl
+            << "  tungsten_book INPUT OUTPUT          Convert a move tree book to a Zobrist indexed book" << std::endl
+            << "  tungsten_book --probe BOOK [FEN]    Print the book moves of a position (default start position)" << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+  std::vector<std::string> args(argv + 1, argv + argc);
+
+  if (args.size() >= 2 && args[0] == "--probe")
+  {
+    std::string fen = "";
+    for (size_t i = 2; i < args.size(); i++)
+      fen += (fen.empty() ? "" : " ") + args[i];
+
+    return probeBook(args[1], fen.empty() ? START_FEN : fen) ? 0 : 1;
+  }
+
+  if (args.size() != 2)
+  {
+    printUsage();
+    return 1;
+  }
+
+  std::vector<OpeningBookEntry> entries;
+  if (!readMoveTreeBook(args[0], entries))
+    return 1;
+
+  size_t moveCount = entries.size();
+  sortAndMergeEntries(entries);
+
+  if (!writeBook(args[1], entries))
+    return 1;
+
+  std::cout << "Converted " << moveCount << " moves to " << entries.size() << " entries" << std::endl;
+  return 0;
+}
\ No newline at end of file
@@ -2,107 +2,113 @@
 
 namespace TungstenChess
 {
-  Move Bot::generateMoveFromInt(MoveInt moveInt)
+  Move Bot::generateBotMove(const SearchLimits &limits)
   {
-    int from = moveInt & 0x3f;
-    int to = (moveInt >> 6) & 0x3f;
+    searchStopped.store(false, std::memory_order_relaxed);
+    pondering.store(limits.ponder, std::memory_order_relaxed);
 
-    Piece piece = board[from];
-    int capturedPiece = board[to];
-
-    return Move(from, to, piece, capturedPiece, board.castlingRights(), board.enPassantFile(), board.halfmoveClock());
+    return searchBestMove(limits);
   }
 
-  Move Bot::generateBotMove()
+  void Bot::startSearch(const SearchLimits &limits, std::function<void(Move)> onSearchFinished)
   {
-    if (openingBook.inOpeningBook && botSettings.useOpeningBook)
-    {
-      openingBook.updateMoveHistory(board.moveHistory());
+    waitForSearch();
 
-      MoveInt moveInt = openingBook.getNextMove();
-
-      if (moveInt != NULL_MOVE)
-      {
-        Move bestMove = generateMoveFromInt(moveInt);
+    searchStopped.store(false, std::memory_order_relaxed);
+    pondering.store(limits.ponder, std::memory_order_relaxed);
 
-        if (botSettings.logSearchInfo)
-          std::cout << "Book move: " << (botSettings.logPGNMoves ? board.getMovePGN(bestMove) : bestMove.getUCI()) << std::endl;
+    searchThread = std::thread([this, limits, onSearchFinished]()
+                               { onSearchFinished(searchBestMove(limits)); });
+  }
 
-        return bestMove;
-      }
+  Move Bot::searchBestMove(const SearchLimits &limits)
+  {
+    if (openingBook.isLoaded() && botSettings.useOpeningBook)
+    {
+      MoveInt moveInt = openingBook.getMove(board.zobristKey());
 
-      openingBook.inOpeningBook = false;
+      // A key collision could give a move that is not legal here, so only play book moves that are
+      if (moveInt != NULL_MOVE)
+        for (Move move : board.getLegalMoves(board.sideToMove()))
+          if (move.toInt() == moveInt)
+          {
+            if (botSettings.logSearchInfo)
+              printOutput("info string Book move: " + (botSettings.logPGNMoves ? board.getMovePGN(move) : move.getUCI()) + "\n");
+
+            return move;
+          }
     }
 
     positionsEvaluated = 0;
+    nodesSearched = 0;
+
+    searchHistory.age();
 
     auto start = std::chrono::high_resolution_clock::now();
 
-    Move bestMove = botSettings.fixedDepthSearch ? generateBestMove(botSettings.maxSearchDepth) : iterativeDeepening(botSettings.maxSearchTime, start);
+    timeManager.init(limits, board.sideToMove());
 
-    if (botSettings.logSearchInfo)
-      std::cout << "Move: " << (botSettings.logPGNMoves ? board.getMovePGN(bestMove) : bestMove.getUCI()) << ", "
-                << "Depth: " << depthSearched << ", "
-                << "Time: " << std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - start).count() << " ms, "
-                << "Positions evaluated: " << positionsEvaluated << std::endl;
+    searchInfoStart = start;
+    searchStart = start;
+    waitingForPonderHit = limits.ponder;
+    searchTimeLimit = timeManager.getHardLimit();
+    searchNodeLimit = limits.nodes;
 
-    return bestMove;
+    int maxDepth = limits.depth ? std::min(limits.depth, MAX_SEARCH_DEPTH) : MAX_SEARCH_DEPTH;
+
+    return botSettings.threads > 1 ? parallelSearch(maxDepth) : iterativeDeepening(maxDepth);
   }
 
-  int Bot::getStaticEvaluation()
+  void Bot::printSearchInfo(int depth, int lineIndex)
   {
-    positionsEvaluated++;
+    const SearchLine &line = searchLines[lineIndex];
+    int score = line.score;
 
-    int gameStatus = board.getGameStatus(board.sideToMove());
+    int time = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - searchInfoStart).count();
+    uint64_t nodes = getTotalNodesSearched();
 
-    if (gameStatus != NO_MATE)
-    {
-      if (gameStatus == LOSE)
-        return NEGATIVE_INFINITY;
-      else
-        return -STALEMATE_PENALTY;
-    }
+    std::ostringstream info;
 
-    int staticEvaluation = getMaterialEvaluation() + getPositionalEvaluation() + getEvaluationBonus();
+    info << "info depth " << depth << " seldepth " << std::max(selectiveDepth, depth) << " multipv " << lineIndex + 1;
 
-    return board.sideToMove() == WHITE ? staticEvaluation : -staticEvaluation;
+    // Mate scores are reported in moves rather than plies, negative if the side to move is getting mated
+    if (isMateScore(score))
+      info << " score mate " << (score > 0 ? (MATE_SCORE - score + 1) / 2 : -(MATE_SCORE + score) / 2);
+    else
+      info << " score cp " << score;
+
+    info << " nodes " << nodes << " nps " << nodes * 1000 / std::max(time, 1) << " time " << time
+         << " hashfull " << transpositionTable->hashfull() << " pv";
+
+    for (const Move &move : line.principalVariation)
+      info << " " << move.getUCI();
+
+    info << "\n";
+
+    printOutput(info.str());
   }
 
-  int Bot::getMaterialEvaluation()
+  int Bot::getStaticEvaluation()
   {
-    int materialEvaluation = 0;
+    positionsEvaluated++;
 
-    materialEvaluation += Bitboards::countBits(board.bitboard(WHITE_PAWN)) * PIECE_VALUES[PAWN];
-    materialEvaluation += Bitboards::countBits(board.bitboard(WHITE_KNIGHT)) * PIECE_VALUES[KNIGHT];
-    materialEvaluation += Bitboards::countBits(board.bitboard(WHITE_BISHOP)) * PIECE_VALUES[BISHOP];
-    materialEvaluation += Bitboards::countBits(board.bitboard(WHITE_ROOK)) * PIECE_VALUES[ROOK];
-    materialEvaluation += Bitboards::countBits(board.bitboard(WHITE_QUEEN)) * PIECE_VALUES[QUEEN];
+    int staticEvaluation = getMaterialEvaluation() + getPositionalEvaluation() + getEvaluationBonus();
 
-    materialEvaluation -= Bitboards::countBits(board.bitboard(BLACK_PAWN)) * PIECE_VALUES[PAWN];
-    materialEvaluation -= Bitboards::countBits(board.bitboard(BLACK_KNIGHT)) * PIECE_VALUES[KNIGHT];
-    materialEvaluation -= Bitboards::countBits(board.bitboard(BLACK_BISHOP)) * PIECE_VALUES[BISHOP];
-    materialEvaluation -= Bitboards::countBits(board.bitboard(BLACK_ROOK)) * PIECE_VALUES[ROOK];
-    materialEvaluation -= Bitboards::countBits(board.bitboard(BLACK_QUEEN)) * PIECE_VALUES[QUEEN];
+    return board.sideToMove() == WHITE ? staticEvaluation : -staticEvaluation;
+  }
 
-    return materialEvaluation;
+  int Bot::getMaterialEvaluation()
+  {
+    return board.materialEvaluation();
   }
 
   int Bot::getPositionalEvaluation()
   {
-    int positionalEvaluation = 0;
+    int positionalEvaluation = board.pieceSquareEvaluation();
 
     Bitboard whitePieces = board.bitboard(WHITE_KNIGHT) | board.bitboard(WHITE_BISHOP) | board.bitboard(WHITE_ROOK) | board.bitboard(WHITE_QUEEN);
     Bitboard blackPieces = board.bitboard(BLACK_KNIGHT) | board.bitboard(BLACK_BISHOP) | board.bitboard(BLACK_ROOK) | board.bitboard(BLACK_QUEEN);
 
-    Bitboard allPieces = whitePieces | board.bitboard(WHITE_PAWN) | blackPieces | board.bitboard(BLACK_PAWN);
-
-    while (allPieces)
-    {
-      int pieceIndex = Bitboards::popBit(allPieces);
-
-      positionalEvaluation += getPiecePositionalEvaluation(pieceIndex);
-    }
-
     {
       int whiteKingIndex = board.kingIndex(WHITE_KING);
 
@@ -169,80 +175,97 @@ namespace TungstenChess
     if (board.hasCastled() & BLACK)
       evaluationBonus -= CASTLED_KING_BONUS;
 
-    for (int i = 0; i < 64; i++)
+    evaluationBonus += getPawnStructureEvaluation().score;
+
+    Bitboard pawns = board.bitboard(WHITE_PAWN) | board.bitboard(BLACK_PAWN);
+
+    for (Bitboard rooks = board.bitboard(WHITE_ROOK); rooks;)
     {
-      int file = i % 8;
-      int rank = i / 8;
+      int file = Bitboards::popBit(rooks) % 8;
 
-      if (rank == 0)
-      {
-        if (Bitboards::countBits(Bitboards::file(board.bitboard(WHITE_PAWN), file)) > 1)
-          evaluationBonus -= DOUBLED_PAWN_PENALTY;
-        if (Bitboards::countBits(Bitboards::file(board.bitboard(BLACK_PAWN), file)) > 1)
-          evaluationBonus += DOUBLED_PAWN_PENALTY;
+      if (!Bitboards::file(pawns, file))
+        evaluationBonus += ROOK_ON_OPEN_FILE_BONUS;
+      else if (!Bitboards::file(board.bitboard(BLACK_PAWN), file))
+        evaluationBonus += ROOK_ON_SEMI_OPEN_FILE_BONUS;
+    }
+    for (Bitboard rooks = board.bitboard(BLACK_ROOK); rooks;)
+    {
+      int file = Bitboards::popBit(rooks) % 8;
 
-        if (Bitboards::file(board.bitboard(WHITE_PAWN), file))
-        {
-          if (!Bitboards::file(board.bitboard(BLACK_PAWN), file - 1) && !Bitboards::file(board.bitboard(BLACK_PAWN), file + 1))
-            evaluationBonus += PASSED_PAWN_BONUS;
-          if (!Bitboards::file(board.bitboard(WHITE_PAWN), file - 1) && !Bitboards::file(board.bitboard(WHITE_PAWN), file + 1))
-            evaluationBonus -= ISOLATED_PAWN_PENALTY;
-        }
-        if (Bitboards::file(board.bitboard(BLACK_PAWN), file))
-        {
-          if (!Bitboards::file(board.bitboard(WHITE_PAWN), file - 1) && !Bitboards::file(board.bitboard(WHITE_PAWN), file + 1))
-            evaluationBonus -= PASSED_PAWN_BONUS;
-          if (!Bitboards::file(board.bitboard(BLACK_PAWN), file - 1) && !Bitboards::file(board.bitboard(BLACK_PAWN), file + 1))
-            evaluationBonus += ISOLATED_PAWN_PENALTY;
-        }
-      }
+      if (!Bitboards::file(pawns, file))
+        evaluationBonus -= ROOK_ON_OPEN_FILE_BONUS;
+      else if (!Bitboards::file(board.bitboard(WHITE_PAWN), file))
+        evaluationBonus -= ROOK_ON_SEMI_OPEN_FILE_BONUS;
+    }
 
-      if (!board[i])
-        continue;
+    for (Bitboard knights = board.bitboard(WHITE_KNIGHT); knights;)
+    {
+      int file = Bitboards::popBit(knights) % 8;
 
-      if (board[i] == WHITE_ROOK)
-      {
-        Bitboard pawns = board.bitboard(WHITE_PAWN) | board.bitboard(BLACK_PAWN);
+      if (file > 0 && file < 7 && !Bitboards::file(board.bitboard(BLACK_PAWN), file - 1) && !Bitboards::file(board.bitboard(BLACK_PAWN), file + 1))
+        evaluationBonus += KNIGHT_OUTPOST_BONUS;
+    }
+    for (Bitboard knights = board.bitboard(BLACK_KNIGHT); knights;)
+    {
+      int file = Bitboards::popBit(knights) % 8;
 
-        if (!Bitboards::file(pawns, file))
-          evaluationBonus += ROOK_ON_OPEN_FILE_BONUS;
-        else if (!Bitboards::file(board.bitboard(BLACK_PAWN), file))
-          evaluationBonus += ROOK_ON_SEMI_OPEN_FILE_BONUS;
+      if (file > 0 && file < 7 && !Bitboards::file(board.bitboard(WHITE_PAWN), file - 1) && !Bitboards::file(board.bitboard(WHITE_PAWN), file + 1))
+        evaluationBonus -= KNIGHT_OUTPOST_BONUS;
+    }
 
-        continue;
-      }
-      if (board[i] == BLACK_ROOK)
-      {
-        Bitboard pawns = board.bitboard(WHITE_PAWN) | board.bitboard(BLACK_PAWN);
+    return evaluationBonus;
+  }
+
+  const PawnHashTableEntry &Bot::getPawnStructureEvaluation()
+  {
+    ZobristKey pawnKey = board.pawnZobristKey();
 
-        if (!Bitboards::file(pawns, file))
-          evaluationBonus -= ROOK_ON_OPEN_FILE_BONUS;
-        else if (!Bitboards::file(board.bitboard(WHITE_PAWN), file))
-          evaluationBonus -= ROOK_ON_SEMI_OPEN_FILE_BONUS;
+    if (const PawnHashTableEntry *entry = pawnHashTable.probe(pawnKey))
+      return *entry;
 
-        continue;
-      }
+    Bitboard whitePawns = board.bitboard(WHITE_PAWN);
+    Bitboard blackPawns = board.bitboard(BLACK_PAWN);
+
+    PawnHashTableEntry entry = {pawnKey, 0, 0, 0};
 
-      if (board[i] == WHITE_KNIGHT)
+    for (int file = 0; file < 8; file++)
+    {
+      Bitboard whiteAdjacentPawns = (file > 0 ? Bitboards::file(whitePawns, file - 1) : 0) | (file < 7 ? Bitboards::file(whitePawns, file + 1) : 0);
+      Bitboard blackAdjacentPawns = (file > 0 ? Bitboards::file(blackPawns, file - 1) : 0) | (file < 7 ? Bitboards::file(blackPawns, file + 1) : 0);
+
+      if (Bitboards::countBits(Bitboards::file(whitePawns, file)) > 1)
+        entry.score -= DOUBLED_PAWN_PENALTY;
+      if (Bitboards::countBits(Bitboards::file(blackPawns, file)) > 1)
+        entry.score += DOUBLED_PAWN_PENALTY;
+
+      if (Bitboards::file(whitePawns, file))
       {
-        if (file > 0 && file < 7 && !Bitboards::file(board.bitboard(BLACK_PAWN), file - 1) && !Bitboards::file(board.bitboard(BLACK_PAWN), file + 1))
-          evaluationBonus += KNIGHT_OUTPOST_BONUS;
-        continue;
+        if (!blackAdjacentPawns)
+        {
+          entry.score += PASSED_PAWN_BONUS;
+          entry.whitePassedPawns |= Bitboards::file(whitePawns, file);
+        }
+        if (!whiteAdjacentPawns)
+          entry.score -= ISOLATED_PAWN_PENALTY;
       }
-      if (board[i] == BLACK_KNIGHT)
+      if (Bitboards::file(blackPawns, file))
       {
-        if (file > 0 && file < 7 && !Bitboards::file(board.bitboard(WHITE_PAWN), file - 1) && !Bitboards::file(board.bitboard(WHITE_PAWN), file + 1))
-          evaluationBonus -= KNIGHT_OUTPOST_BONUS;
-        continue;
+        if (!whiteAdjacentPawns)
+        {
+          entry.score -= PASSED_PAWN_BONUS;
+          entry.blackPassedPawns |= Bitboards::file(blackPawns, file);
+        }
+        if (!blackAdjacentPawns)
+          entry.score += ISOLATED_PAWN_PENALTY;
       }
     }
 
-    return evaluationBonus;
+    return pawnHashTable.store(entry);
   }
 
   Move Bot::generateOneDeepMove()
   {
-    std::vector<Move> legalMoves = board.getLegalMoves(board.sideToMove());
+    MoveList legalMoves = board.getLegalMoves(board.sideToMove());
 
     int legalMovesCount = legalMoves.size();
 
@@ -253,7 +276,9 @@ namespace TungstenChess
     {
       board.makeMove(legalMoves[i]);
 
-      int evaluation = getStaticEvaluation();
+      // Static evaluation does not detect the end of the game, and there is no search below this move to detect it
+      int gameStatus = board.getGameStatus(board.sideToMove());
+      int evaluation = gameStatus == LOSE ? -MATE_SCORE + 1 : gameStatus == STALEMATE ? -STALEMATE_PENALTY : getStaticEvaluation();
 
       board.unmakeMove(legalMoves[i]);
 
@@ -264,48 +289,157 @@ namespace TungstenChess
       }
     }
 
+    searchScore = -bestMoveEvaluation;
+
+    pvLength[0] = 1;
+    pvTable[0][0] = legalMoves[bestMoveIndex];
+
     return legalMoves[bestMoveIndex];
   }
 
-  int Bot::negamax(int depth, int alpha, int beta)
+  int Bot::negamax(int depth, int ply, int alpha, int beta, bool allowNullMove)
   {
     if (depth == 0)
-      return quiesce(botSettings.quiesceDepth, alpha, beta);
+      return quiesce(botSettings.quiesceDepth, ply, alpha, beta);
 
-    if (board.countRepetitions(board.zobristKey()) >= 3 || board.halfmoveClock() >= 100)
-      return -STALEMATE_PENALTY;
+    pvLength[ply] = ply;
+    selectiveDepth = std::max(selectiveDepth, ply);
 
-    std::vector<Move> legalMoves = getSortedLegalMoves(board.sideToMove());
+    countNode();
 
-    int legalMovesCount = legalMoves.size();
+    if (isSearchStopped())
+      return 0;
 
-    if (legalMovesCount == 0)
-      return board.isInCheck(board.sideToMove()) ? NEGATIVE_INFINITY : -STALEMATE_PENALTY;
+    if (board.isRepetition(ply) || board.halfmoveClock() >= 100)
+      return DRAW_SCORE;
 
-    for (int i = 0; i < legalMovesCount; i++)
+    bool isNullWindow = beta - alpha == 1;
+
+    TranspositionTableEntry entry;
+    MoveInt hashMove = NULL_MOVE;
+
+    if (transpositionTable->probe(board.zobristKey(), entry))
     {
-      board.makeMove(legalMoves[i]);
-      int evaluation = -negamax(depth - 1, -beta, -alpha);
-      board.unmakeMove(legalMoves[i]);
+      hashMove = entry.bestMove;
+
+      int score = scoreFromTranspositionTable(entry.score, ply);
+
+      // Not at PV nodes, where the cutoff would return before the PV of this ply is written and truncate the parent's PV
+      if (isNullWindow && entry.depth >= depth)
+      {
+        if (entry.bound == EXACT_BOUND)
+          return score;
+        if (entry.bound == LOWER_BOUND && score >= beta)
+          return beta;
+        if (entry.bound == UPPER_BOUND && score <= alpha)
+          return alpha;
+      }
+    }
+
+    bool inCheck = board.isInCheck(board.sideToMove());
+
+    // If passing the turn still fails high, a real move almost certainly would too (not tried in zugzwang-prone positions)
+    if (botSettings.useNullMovePruning && allowNullMove && isNullWindow && !inCheck && depth >= NULL_MOVE_MIN_DEPTH && hasNonPawnMaterial(board.sideToMove()))
+    {
+      int reduction = 2 + depth / 4;
+
+      board.makeNullMove();
+      int evaluation = -negamax(std::max(depth - 1 - reduction, 0), ply + 1, -beta, -beta + 1, false);
+      board.unmakeNullMove();
+
+      if (isSearchStopped())
+        return 0;
+
+      if (evaluation >= beta)
+        return beta;
+    }
+
+    MovePicker movePicker(board, hashMove, searchHistory, ply);
+
+    TranspositionTableBound bound = UPPER_BOUND;
+    MoveInt bestMove = NULL_MOVE;
+
+    int legalMovesCount = 0;
+
+    Move move;
+
+    while (movePicker.nextMove(move))
+    {
+      legalMovesCount++;
+
+      bool isQuiet = !(move.flags() & (CAPTURE | EP_CAPTURE | PROMOTION));
+
+      board.makeMove(move);
+
+      int evaluation;
+
+      if (legalMovesCount == 1)
+        evaluation = -negamax(depth - 1, ply + 1, -beta, -alpha);
+      else
+      {
+        int reduction = 0;
+
+        if (botSettings.useLateMoveReductions && isQuiet && !inCheck && depth >= LMR_MIN_DEPTH && legalMovesCount >= LMR_MIN_MOVE_NUMBER && !board.isInCheck(board.sideToMove()))
+          reduction = std::clamp(lateMoveReductions.get(depth, legalMovesCount), 0, depth - 2);
+
+        evaluation = -negamax(depth - 1 - reduction, ply + 1, -alpha - 1, -alpha);
+
+        if (reduction && evaluation > alpha)
+          evaluation = -negamax(depth - 1, ply + 1, -alpha - 1, -alpha);
+
+        if (evaluation > alpha && evaluation < beta)
+          evaluation = -negamax(depth - 1, ply + 1, -beta, -alpha);
+      }
+
+      board.unmakeMove(move);
+
+      if (isSearchStopped())
+        return 0;
 
       if (evaluation > alpha)
       {
         alpha = evaluation;
+        bound = EXACT_BOUND;
+        bestMove = move.toInt();
 
         if (alpha >= beta)
+        {
+          if (isQuiet)
+            searchHistory.updateCutoff(board.sideToMove(), bestMove, ply, depth, board.lastMove());
+
+          transpositionTable->store(board.zobristKey(), depth, scoreToTranspositionTable(beta, ply), LOWER_BOUND, bestMove);
           return beta;
+        }
+
+        updatePrincipalVariation(ply, move);
       }
     }
 
+    if (legalMovesCount == 0)
+      return inCheck ? -MATE_SCORE + ply : -STALEMATE_PENALTY;
+
+    transpositionTable->store(board.zobristKey(), depth, scoreToTranspositionTable(alpha, ply), bound, bestMove);
+
     return alpha;
   }
 
-  int Bot::quiesce(int depth, int alpha, int beta)
+  int Bot::quiesce(int depth, int ply, int alpha, int beta)
   {
-    int standPat = getStaticEvaluation();
+    pvLength[ply] = ply;
+    selectiveDepth = std::max(selectiveDepth, ply);
 
-    if (depth == 0)
-      return standPat;
+    countNode();
+
+    if (isSearchStopped())
+      return 0;
+
+    // In check, standing pat is not an option, so all evasions are searched instead of only captures
+    bool inCheck = board.isInCheck(board.sideToMove());
+
+    int standPat = inCheck ? NEGATIVE_INFINITY : getStaticEvaluation();
+
+    if (depth == 0 || ply >= MAX_PLY - 1)
+      return inCheck ? getStaticEvaluation() : standPat;
 
     if (standPat > alpha)
       alpha = standPat;
@@ -313,31 +447,69 @@ namespace TungstenChess
     if (alpha >= beta)
       return beta;
 
-    if (board.countRepetitions(board.zobristKey()) >= 3 || board.halfmoveClock() >= 100)
-      return -STALEMATE_PENALTY;
+    if (board.isRepetition(ply) || board.halfmoveClock() >= 100)
+      return DRAW_SCORE;
 
-    std::vector<Move> legalMoves = getSortedLegalMoves(board.sideToMove(), true);
+    TranspositionTableEntry entry;
+    MoveInt hashMove = NULL_MOVE;
 
-    int legalMovesCount = legalMoves.size();
+    // Quiescence results are stored at depth 0, so any entry for this position is deep enough to be used
+    if (transpositionTable->probe(board.zobristKey(), entry))
+    {
+      hashMove = entry.bestMove;
 
-    if (legalMovesCount == 0)
-      return standPat;
+      int score = scoreFromTranspositionTable(entry.score, ply);
 
-    for (int i = 0; i < legalMovesCount; i++)
+      if (entry.bound == EXACT_BOUND)
+        return score;
+      if (entry.bound == LOWER_BOUND && score >= beta)
+        return beta;
+      if (entry.bound == UPPER_BOUND && score <= alpha)
+        return alpha;
+    }
+
+    MovePicker movePicker(board, hashMove, searchHistory, 0, !inCheck);
+
+    TranspositionTableBound bound = UPPER_BOUND;
+    MoveInt bestMove = NULL_MOVE;
+
+    int legalMovesCount = 0;
+
+    Move move;
+
+    while (movePicker.nextMove(move))
     {
-      board.makeMove(legalMoves[i]);
-      int evaluation = -quiesce(depth - 1, -beta, -alpha);
-      board.unmakeMove(legalMoves[i]);
+      legalMovesCount++;
+
+      board.makeMove(move);
+      int evaluation = -quiesce(depth - 1, ply + 1, -beta, -alpha);
+      board.unmakeMove(move);
+
+      if (isSearchStopped())
+        return 0;
 
       if (evaluation > alpha)
       {
         alpha = evaluation;
+        bound = EXACT_BOUND;
+        bestMove = move.toInt();
 
         if (alpha >= beta)
+        {
+          transpositionTable->store(board.zobristKey(), 0, scoreToTranspositionTable(beta, ply), LOWER_BOUND, bestMove);
           return beta;
+        }
+
+        updatePrincipalVariation(ply, move);
       }
     }
 
+    // Without captures, the position is not checked for stalemate (it would need a full legal move generation)
+    if (legalMovesCount == 0)
+      return inCheck ? -MATE_SCORE + ply : standPat;
+
+    transpositionTable->store(board.zobristKey(), 0, scoreToTranspositionTable(alpha, ply), bound, bestMove);
+
     return alpha;
   }
 
@@ -348,64 +520,225 @@ namespace TungstenChess
     if (depth == 0)
       return generateOneDeepMove();
 
-    std::vector<Move> legalMoves = getSortedLegalMoves(board.sideToMove());
+    pvLength[0] = 0;
 
-    int legalMovesCount = legalMoves.size();
+    TranspositionTableEntry entry;
+    MoveInt hashMove = NULL_MOVE;
 
-    int bestMoveIndex = 0;
+    if (transpositionTable->probe(board.zobristKey(), entry))
+      hashMove = entry.bestMove;
 
-    for (int i = 0; i < legalMovesCount; i++)
+    MovePicker movePicker(board, hashMove, searchHistory, 0);
+
+    TranspositionTableBound bound = UPPER_BOUND;
+    Move bestMove = Move::nullMove(); // Stays the null move if there are no legal moves
+    Move move;
+
+    bool hasLegalMoves = false;
+
+    while (movePicker.nextMove(move))
     {
-      board.makeMove(legalMoves[i]);
-      int evaluation = -negamax(depth - 1, -beta, -alpha);
-      board.unmakeMove(legalMoves[i]);
+      if (std::find(excludedRootMoves.begin(), excludedRootMoves.end(), move.toInt()) != excludedRootMoves.end())
+        continue;
+
+      board.makeMove(move);
+
+      int evaluation;
+
+      if (!hasLegalMoves)
+      {
+        bestMove = move;
+        hasLegalMoves = true;
+
+        evaluation = -negamax(depth - 1, 1, -beta, -alpha);
+      }
+      else
+      {
+        evaluation = -negamax(depth - 1, 1, -alpha - 1, -alpha);
+
+        if (evaluation > alpha && evaluation < beta)
+          evaluation = -negamax(depth - 1, 1, -beta, -alpha);
+      }
+
+      board.unmakeMove(move);
+
+      if (isSearchStopped())
+        return bestMove;
 
       if (evaluation > alpha)
       {
         alpha = evaluation;
-        bestMoveIndex = i;
+        bound = EXACT_BOUND;
+        bestMove = move;
+
+        updatePrincipalVariation(0, move);
 
         if (alpha >= beta)
+        {
+          bound = LOWER_BOUND;
+          alpha = beta;
           break;
+        }
       }
     }
 
-    return legalMoves[bestMoveIndex];
+    searchScore = alpha;
+
+    // With excluded moves, the score is not the score of the position
+    if (hasLegalMoves && excludedRootMoves.empty())
+      transpositionTable->store(board.zobristKey(), depth, alpha, bound, bestMove.toInt());
+    else if (!hasLegalMoves)
+      searchScore = board.isInCheck(board.sideToMove()) ? -MATE_SCORE : -STALEMATE_PENALTY;
+
+    return bestMove;
+  }
+
+  Move Bot::aspirationSearch(int depth, int previousScore)
+  {
+    int window = ASPIRATION_WINDOW;
+
+    int alpha = std::max(previousScore - window, NEGATIVE_INFINITY);
+    int beta = std::min(previousScore + window, POSITIVE_INFINITY);
+
+    while (true)
+    {
+      Move bestMove = generateBestMove(depth, alpha, beta);
+
+      if (isSearchStopped() || (searchScore > alpha && searchScore < beta))
+        return bestMove;
+
+      // A failed search is only a bound, so the window is widened on the failing side and the depth is searched again
+      window *= 2;
+
+      if (window > MAX_ASPIRATION_WINDOW)
+      {
+        alpha = NEGATIVE_INFINITY;
+        beta = POSITIVE_INFINITY;
+      }
+      else if (searchScore <= alpha)
+        alpha = std::max(previousScore - window, NEGATIVE_INFINITY);
+      else
+        beta = std::min(previousScore + window, POSITIVE_INFINITY);
+
+      if (alpha == NEGATIVE_INFINITY && beta == POSITIVE_INFINITY)
+        return generateBestMove(depth);
+    }
   }
 
-  Move Bot::iterativeDeepening(int time, std::chrono::time_point<std::chrono::high_resolution_clock> start)
+  Move Bot::iterativeDeepening(int maxDepth)
   {
-    int depth = botSettings.minSearchDepth;
+    int firstDepth = std::min(botSettings.minSearchDepth, maxDepth);
+
+    // There cannot be more lines than legal moves, but without legal moves one line is still searched to find the mate or stalemate score
+    int lineCount = std::clamp((int)board.getLegalMoves(board.sideToMove()).size(), 1, std::max(botSettings.multiPV, 1));
 
-    Move bestMove = generateBestMove(depth);
+    Move bestMove = Move::nullMove();
+    Move firstLineMove = Move::nullMove();
 
-    while (std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - start).count() < time)
+    searchLines.clear();
+
+    for (int depth = firstDepth; depth <= maxDepth; depth++)
     {
-      depth++;
+      selectiveDepth = 0;
+
+      std::vector<SearchLine> newLines;
+
+      // Each line searches the root moves not in a better line yet, reusing the transposition table and move ordering of the previous lines
+      for (int i = 0; i < lineCount; i++)
+      {
+        Move move = depth == firstDepth ? generateBestMove(depth) : aspirationSearch(depth, searchLines[i].score);
+
+        if (i == 0)
+          firstLineMove = move;
 
-      Move newBestMove = generateBestMove(depth);
+        if (isSearchStopped())
+          break;
+
+        newLines.push_back({move, searchScore, std::vector<Move>(pvTable[0].begin(), pvTable[0].begin() + pvLength[0])});
+        excludedRootMoves.push_back(move.toInt());
+      }
+
+      excludedRootMoves.clear();
+
+      if (isSearchStopped())
+      {
+        // Without a completed iteration, the best move found so far in the first one is still better than none
+        if (depth == firstDepth)
+          bestMove = firstLineMove;
+        else
+          depthSearched = depth - 1;
+        break;
+      }
 
-      bestMove = newBestMove;
+      // A later line can score higher than an earlier one when the search is unstable
+      std::stable_sort(newLines.begin(), newLines.end(), [](const SearchLine &a, const SearchLine &b)
+                       { return a.score > b.score; });
+
+      searchLines = newLines;
+      bestMove = searchLines.front().move;
+
+      if (botSettings.logSearchInfo)
+        for (size_t i = 0; i < searchLines.size(); i++)
+          printSearchInfo(depth, i);
+
+      // Without legal moves there is nothing to search deeper
+      if (searchLines.front().principalVariation.empty())
+        break;
+
+      timeManager.updateBestMove(bestMove.toInt());
+
+      if (!timeManager.canStartIteration(getSearchTime()))
+        break;
     }
 
     return bestMove;
   }
 
-  void Bot::heuristicSortMoves(std::vector<Move> &moves)
+  Move Bot::parallelSearch(int maxDepth)
   {
-    std::sort(moves.begin(), moves.end(), [this](Move a, Move b)
-              { return heuristicEvaluation(a) > heuristicEvaluation(b); });
+    int helperCount = botSettings.threads - 1;
+
+    std::vector<Board> helperBoards(helperCount, board);
+    std::vector<std::thread> helperThreads;
+
+    for (int i = 0; i < helperCount; i++)
+    {
+      helperBots.emplace_back(new Bot(helperBoards[i], botSettings, transpositionTable));
+      helperThreads.emplace_back(&Bot::helperSearch, helperBots[i].get(), i + 1);
+    }
+
+    Move bestMove = iterativeDeepening(maxDepth);
+
+    for (int i = 0; i < helperCount; i++)
+    {
+      helperBots[i]->stopSearch();
+      helperThreads[i].join();
+
+      positionsEvaluated += helperBots[i]->positionsEvaluated;
+    }
+
+    helperBots.clear();
+
+    return bestMove;
   }
 
-  int Bot::heuristicEvaluation(Move move)
+  void Bot::helperSearch(int threadIndex)
   {
-    int evaluation = 0;
+    positionsEvaluated = 0;
+    nodesSearched = 0;
+    reportedNodes.store(0, std::memory_order_relaxed);
 
-    evaluation += PIECE_VALUES[move.capturedPiece & TYPE] * (move.flags & CAPTURE);
-    evaluation += PIECE_VALUES[move.promotionPieceType] * (move.flags & PROMOTION);
+    // Odd helpers start one ply deeper so that the threads are spread over different depths
+    int depth = 1 + threadIndex % 2;
 
-    evaluation += getPiecePositionalEvaluation(move.to, true) - getPiecePositionalEvaluation(move.from, true);
+    generateBestMove(depth);
 
-    return evaluation;
+    int score = searchScore;
+
+    for (depth++; depth <= MAX_SEARCH_DEPTH && !isSearchStopped(); depth++)
+    {
+      aspirationSearch(depth, score);
+      score = searchScore;
+    }
   }
 }
\ No newline at end of file
@@ -0,0 +1,235 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdint>
+#include <cctype>
+
+#include "board.hpp"
+
+using namespace TungstenChess;
+
+// Standard perft positions (https://www.chessprogramming.org/Perft_Results) in EPD format, each followed by its known node counts
+const std::vector<std::string> DEFAULT_SUITE = {
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1 ;D1 20 ;D2 400 ;D3 8902 ;D4 197281 ;D5 4865609 ;D6 119060324",
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1 ;D1 48 ;D2 2039 ;D3 97862 ;D4 4085603 ;D5 193690690",
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1 ;D1 14 ;D2 191 ;D3 2812 ;D4 43238 ;D5 674624 ;D6 11030083 ;D7 178633661",
+    "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1 ;D1 6 ;D2 264 ;D3 9467 ;D4 422333 ;D5 15833292",
+    "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8 ;D1 44 ;D2 1486 ;D3 62379 ;D4 2103487 ;D5 89941194",
+    "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10 ;D1 46 ;D2 2079 ;D3 89890 ;D4 3894594 ;D5 164075551"};
+
+struct PerftCase
+{
+  std::string fen;
+  std::vector<std::pair<int, uint64_t>> expected; // (depth, node count) pairs
+};
+
+/**
+ * @brief Parses an EPD perft line of the form "<fen> ;D1 <nodes> ;D2 <nodes> ..."
+ * @param line The line to parse
+ * @param perftCase The case to fill
+ * @return Whether the line held a position (false for blank lines and comments)
+ */
+bool parseEPDLine(const std::string &line, PerftCase &perftCase)
+{
+  size_t firstChar = line.find_first_not_of(" \t\r");
+  if (firstChar == std::string::npos || line[firstChar] == '#')
+    return false;
+
+  std::stringstream stream(line.substr(firstChar));
+  std::string field;
+
+  std::getline(stream, perftCase.fen, ';');
+  perftCase.fen = perftCase.fen.substr(0, perftCase.fen.find_last_not_of(" \t\r") + 1);
+  perftCase.expected.clear();
+
+  while (std::getline(stream, field, ';'))
+  {
+    std::stringstream fieldStream(field);
+    std::string depthString;
+    uint64_t nodes;
+
+    if (fieldStream >> depthString >> nodes && depthString.size() > 1 && depthString[0] == 'D')
+      perftCase.expected.push_back({std::stoi(depthString.substr(1)), nodes});
+  }
+
+  return true;
+}
+
+/**
+ * @brief Prints the node count and speed of a perft run
+ * @param nodes The number of nodes counted
+ * @param seconds The time the run took
+ */
+void printSpeed(uint64_t nodes, double seconds)
+{
+  std::cout << "Nodes: " << nodes << ", Time: " << (int)(seconds * 1000) << " ms, NPS: " << (uint64_t)(nodes / std::max(seconds, 1e-9)) << std::endl;
+}
+
+/**
+ * @brief Runs perft on a position, printing the node count of each root move
+ * @param fen The position to run perft on
+ * @param depth The depth to count to
+ */
+void divide(const std::string &fen, int depth)
+{
+  Board board(fen);
+
+  auto start = std::chrono::steady_clock::now();
+  uint64_t total = 0;
+
+  for (Move move : board.getLegalMoves(board.sideToMove()))
+  {
+    board.makeMove(move);
+    uint64_t nodes = depth > 1 ? board.countGames(depth - 1) : 1;
+    board.unmakeMove(move);
+
+    std::cout << move.getUCI() << ": " << nodes << std::endl;
+    total += nodes;
+  }
+
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+  std::cout << std::endl;
+  printSpeed(total, elapsed.count());
+}
+
+/**
+ * @brief Runs every case of a perft suite up to a maximum depth, printing pass/fail for each
+ * @param suite The cases to run
+ * @param maxDepth Expected counts deeper than this are skipped
+ * @return Whether every count matched
+ */
+bool runSuite(const std::vector<PerftCase> &suite, int maxDepth)
+{
+  int passed = 0, failed = 0;
+  uint64_t totalNodes = 0;
+  double totalSeconds = 0;
+
+  for (const PerftCase &perftCase : suite)
+  {
+    Board board(perftCase.fen);
+
+    std::cout << perftCase.fen << std::endl;
+
+    for (auto [depth, expected] : perftCase.expected)
+    {
+      if (depth > maxDepth)
+        continue;
+
+      auto start = std::chrono::steady_clock::now();
+      uint64_t nodes = board.countGames(depth);
+      std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+      totalNodes += nodes;
+      totalSeconds += elapsed.count();
+
+      bool pass = nodes == expected;
+      pass ? passed++ : failed++;
+
+      std::cout << "  D" << depth << " " << (pass ? "PASS" : "FAIL") << " " << nodes;
+      if (!pass)
+        std::cout << " (expected " << expected << ")";
+      std::cout << ", " << (int)(elapsed.count() * 1000) << " ms" << std::endl;
+    }
+  }
+
+  std::cout << std::endl
+            << passed << " passed, " << failed << " failed" << std::endl;
+  printSpeed(totalNodes, totalSeconds);
+
+  return failed == 0;
+}
+
+void printUsage()
+{
+  std::cout << "Usage:" << std::endl
+            << "  tungsten_perft [--max-depth N]               Run the built-in suite of standard positions" << std::endl
+            << "  tungsten_perft --epd FILE [--max-depth N]    Run the positions of an EPD perft suite" << std::endl
+            << "  tungsten_perft DEPTH [FEN]                   Count the nodes of one position (default start position)" << std::endl
+            << "  tungsten_perft --divide DEPTH [FEN]          Count the nodes after each root move" << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+  std::vector<std::string> args(argv + 1, argv + argc);
+
+  bool isDivide = !args.empty() && args[0] == "--divide";
+
+  if (!args.empty() && (isDivide || std::isdigit(args[0][0])))
+  {
+    size_t depthIndex = isDivide ? 1 : 0;
+    if (depthIndex >= args.size() || !std::isdigit(args[depthIndex][0]))
+    {
+      printUsage();
+      return 1;
+    }
+
+    int depth = std::stoi(args[depthIndex]);
+
+    std::string fen = "";
+    for (size_t i = depthIndex + 1; i < args.size(); i++)
+      fen += (fen.empty() ? "" : " ") + args[i];
+
+    if (fen.empty())
+      fen = START_FEN;
+
+    if (isDivide)
+    {
+      divide(fen, depth);
+      return 0;
+    }
+
+    Board board(fen);
+
+    auto start = std::chrono::steady_clock::now();
+    uint64_t nodes = board.countGames(depth);
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    printSpeed(nodes, elapsed.count());
+    return 0;
+  }
+
+  std::string epdPath = "";
+  int maxDepth = INT32_MAX;
+
+  for (size_t i = 0; i < args.size(); i++)
+  {
+    if (args[i] == "--epd" && i + 1 < args.size())
+      epdPath = args[++i];
+    else if (args[i] == "--max-depth" && i + 1 < args.size())
+      maxDepth = std::stoi(args[++i]);
+    else
+    {
+      printUsage();
+      return 1;
+    }
+  }
+
+  std::vector<std::string> lines = DEFAULT_SUITE;
+
+  if (!epdPath.empty())
+  {
+    std::ifstream file(epdPath);
+    if (!file)
+    {
+      std::cerr << "Could not open " << epdPath << std::endl;
+      return 1;
+    }
+
+    lines.clear();
+    for (std::string line; std::getline(file, line);)
+      lines.push_back(line);
+  }
+
+  std::vector<PerftCase> suite;
+  PerftCase perftCase;
+
+  for (const std::string &line : lines)
+    if (parseEPDLine(line, perftCase))
+      suite.push_back(perftCase);
+
+  return runSuite(suite, maxDepth) ? 0 : 1;
+}
\ No newline at end of file